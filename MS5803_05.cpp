@@ -32,6 +32,9 @@
  */
 
 #include "MS5803_05.h"
+#include "MS5803_LUT.h"
+#include "MS5803_Bus.h"
+#include "MS5803_Sim.h"
 #include <Wire.h>
 
 // For I2C, set the CSB Pin (pin 3) high for address 0x76, and pull low
@@ -41,12 +44,21 @@
 // Some constants used in calculations below
 #define POW_2_33 8589934592ULL;
 
+// Time waited for each ADC conversion, indexed by OSR (256, 512, 1024, 2048,
+// 4096). See table on page 1 of the MS5803 data sheet showing response times 
+// of 0.5, 1.1, 2.1, 4.1, 8.22 ms for each accuracy level. 
+static const uint8_t convDelayMs[5] = {1, 3, 4, 6, 10};
+// Typical RMS pressure noise in mbar at each OSR (MS5803-05BA data sheet)
+static const float noiseMbar[5] = {0.13, 0.084, 0.054, 0.036, 0.024};
+
 //-------------------------------------------------
 // Constructor
-MS_5803::MS_5803( uint16_t Resolution) {
+MS_5803::MS_5803( uint16_t Resolution, uint8_t Address, TwoWire &Bus) {
 	// The argument is the oversampling resolution, which may have values
 	// of 256, 512, 1024, 2048, or 4096.
 	_Resolution = Resolution;
+	_address = Address;
+	_wire = &Bus;
 
     dT = 0;
     TEMP = 0;
@@ -55,11 +67,37 @@ MS_5803::MS_5803( uint16_t Resolution) {
     varT2 = 0;
     OFF2 = 0;
     Sens2 = 0;
+    _conversion = MS5803_CONVERT_INTEGER;
+    lut = NULL;
+    arbiter = NULL;
+    _priority = 0;
+    _busTimeoutUs = 0;
+    simulator = NULL;
+    simResult = 0;
+    adcFailed = false;
+    // The calibration and bus clock are kept if the object was in RTC 
+    // memory across deep sleep; anywhere else their check fails and they
+    // start cleared. The check is read as whatever the memory holds, not 
+    // assumed to be set.
+    if (*(volatile uint32_t *)&keptCheck != keptHash()) {
+    	calOffset = 0;
+    	calGain = 0;
+    	_busClock = 0;
+    	for (uint8_t i = 0; i < MS5803_CLOCK_STEPS; i++) {
+    		clockLatency[i] = 0;
+    	}
+    	keep();
+    }
+    resetActivity();
 }
 
 //-------------------------------------------------
 boolean MS_5803::initializeMS_5803(boolean Verbose) {
-    Wire.begin();
+    _wire->begin();
+    // Use the bus clock found by negotiateClock(), if it has been run
+    if (_busClock) {
+    	_wire->setClock(_busClock);
+    }
     // Reset the sensor during startup
     resetSensor(); 
     
@@ -78,16 +116,7 @@ boolean MS_5803::initializeMS_5803(boolean Verbose) {
     }
 	// Read sensor coefficients
     for (int i = 0; i < 8; i++ ){
-    	// The PROM starts at address 0xA0
-    	Wire.beginTransmission(MS5803_I2C_ADDRESS);
-    	Wire.write(0xA0 + (i * 2));
-    	Wire.endTransmission();
-    	Wire.requestFrom(MS5803_I2C_ADDRESS, 2);
-    	while(Wire.available()) {
-    		HighByte = Wire.read();
-    		LowByte = Wire.read();
-    	}
-    	sensorCoeffs[i] = (((uint16_t)HighByte << 8) + LowByte);
+    	sensorCoeffs[i] = readPROM(i);
     	if (Verbose){
 			// Print out coefficients 
 			Serial.print("C");
@@ -97,6 +126,8 @@ boolean MS_5803::initializeMS_5803(boolean Verbose) {
 			delay(10);
     	}
     }
+    // Derive the per-device constants used by the conversion
+    prepareCoefficients();
     // The last 4 bits of the 7th coefficient form a CRC error checking code.
     uint8_t p_crc = sensorCoeffs[7];
     // Use a function to calculate the CRC value
@@ -118,30 +149,149 @@ boolean MS_5803::initializeMS_5803(boolean Verbose) {
 }
 
 //------------------------------------------------------------------
-void MS_5803::readSensor() {
+boolean MS_5803::readSensor() {
 	// Choose from CMD_ADC_256, 512, 1024, 2048, 4096 for mbar resolutions
 	// of 1, 0.6, 0.4, 0.3, 0.2 respectively. Higher resolutions take longer
 	// to read.
-	if (_Resolution == 256){
-		varD1 = MS_5803_ADC(CMD_ADC_D1 + CMD_ADC_256); // read raw pressure
-		varD2 = MS_5803_ADC(CMD_ADC_D2 + CMD_ADC_256); // read raw temperature	
-	} else if (_Resolution == 512) {
-		varD1 = MS_5803_ADC(CMD_ADC_D1 + CMD_ADC_512); // read raw pressure
-		varD2 = MS_5803_ADC(CMD_ADC_D2 + CMD_ADC_512); // read raw temperature		
-	} else if (_Resolution == 1024) {
-		varD1 = MS_5803_ADC(CMD_ADC_D1 + CMD_ADC_1024); // read raw pressure
-		varD2 = MS_5803_ADC(CMD_ADC_D2 + CMD_ADC_1024); // read raw temperature
-	} else if (_Resolution == 2048) {
-		varD1 = MS_5803_ADC(CMD_ADC_D1 + CMD_ADC_2048); // read raw pressure
-		varD2 = MS_5803_ADC(CMD_ADC_D2 + CMD_ADC_2048); // read raw temperature
-	} else if (_Resolution == 4096) {
-		varD1 = MS_5803_ADC(CMD_ADC_D1 + CMD_ADC_4096); // read raw pressure
-		varD2 = MS_5803_ADC(CMD_ADC_D2 + CMD_ADC_4096); // read raw temperature
+	char osr = osrCommand();
+	uint32_t d1 = MS_5803_ADC(CMD_ADC_D1 + osr); // read raw pressure
+	if (adcFailed) {
+		return false;
+	}
+	uint32_t d2 = MS_5803_ADC(CMD_ADC_D2 + osr); // read raw temperature
+	if (adcFailed) {
+		return false;
 	}
+	varD1 = d1;
+	varD2 = d2;
     convertRaw(varD1, varD2);
+    return true;
 }
 
-void MS_5803::convertRaw(uint32_t d1Val, uint32_t d2Val) {
+//------------------------------------------------------------------
+// Helpers for the int64-free conversion path. A 64-bit two's complement
+// value is held as two 32-bit halves, and only the operations the 
+// conversion needs are provided. On 8-bit AVRs these replace the software
+// int64_t multiply and divide routines with a few 16 x 16 bit hardware 
+// multiplies and shifts.
+struct MS_5803_Wide {
+    uint32_t hi;
+    uint32_t lo;
+};
+
+// Sign extends a 32-bit value
+static inline MS_5803_Wide wideFrom(int32_t v) {
+    MS_5803_Wide w;
+    w.lo = (uint32_t)v;
+    w.hi = v < 0 ? 0xFFFFFFFFUL : 0;
+    return w;
+}
+
+static inline MS_5803_Wide wideAdd(MS_5803_Wide a, MS_5803_Wide b) {
+    MS_5803_Wide w;
+    w.lo = a.lo + b.lo;
+    w.hi = a.hi + b.hi + (w.lo < a.lo);
+    return w;
+}
+
+static inline MS_5803_Wide wideNeg(MS_5803_Wide a) {
+    MS_5803_Wide w;
+    w.lo = ~a.lo + 1;
+    w.hi = ~a.hi + (w.lo == 0);
+    return w;
+}
+
+// Full 64-bit product of two unsigned 32-bit values, from four 16 x 16 bit
+// partial products.
+static MS_5803_Wide wideMul(uint32_t a, uint32_t b) {
+    uint16_t al = a & 0xFFFF;
+    uint16_t ah = a >> 16;
+    uint16_t bl = b & 0xFFFF;
+    uint16_t bh = b >> 16;
+    uint32_t p0 = (uint32_t)al * bl;
+    uint32_t p1 = (uint32_t)al * bh;
+    uint32_t p2 = (uint32_t)ah * bl;
+    uint32_t p3 = (uint32_t)ah * bh;
+    uint32_t mid = (p0 >> 16) + (p1 & 0xFFFF) + (p2 & 0xFFFF);
+    MS_5803_Wide w;
+    w.lo = (mid << 16) | (p0 & 0xFFFF);
+    w.hi = p3 + (p1 >> 16) + (p2 >> 16) + (mid >> 16);
+    return w;
+}
+
+// Product of a signed and an unsigned 32-bit value. The low 64 bits of a
+// two's complement product don't depend on the signs, so the unsigned 
+// product only needs its high half corrected for a negative 'a'.
+static inline MS_5803_Wide wideMulSigned(int32_t a, uint32_t b) {
+    MS_5803_Wide w = wideMul((uint32_t)a, b);
+    if (a < 0) {
+    	w.hi -= b;
+    }
+    return w;
+}
+
+// Signed division by 2^n (0 < n < 32), truncating toward zero like the 
+// '/' operator does.
+static MS_5803_Wide wideDivPow2(MS_5803_Wide a, uint8_t n) {
+    boolean negative = a.hi & 0x80000000UL;
+    if (negative) {
+    	a = wideNeg(a);
+    }
+    a.lo = (a.lo >> n) | (a.hi << (32 - n));
+    a.hi = a.hi >> n;
+    return negative ? wideNeg(a) : a;
+}
+
+//------------------------------------------------------------------
+// Compensates the raw values like convert64(), giving bit-exact results
+// without any 64-bit integer math for 24-bit D1 values and a first order
+// TEMP above -150 C. Below that the second order terms overflow 32 bits,
+// here as in convert64(). See the MS5803_05_verify example. Sets TEMP and
+// mbarInt.
+void MS_5803::convert32(uint32_t d1Val, uint32_t d2Val) {
+    dT = (int32_t)d2Val - ( (int32_t)sensorCoeffs[5] * 256 );
+    // TEMP = 2000 + dT * C6 / 2^23
+    TEMP = 2000 + (int32_t)wideDivPow2(wideMulSigned(dT, sensorCoeffs[6]), 23).lo;
+    
+    int32_t t2 = 0;
+    int32_t off2 = 0;
+    int32_t sens2 = 0;
+    if (TEMP < 2000) {
+    	// T2 = 3 * dT^2 / 2^33, with |dT| < 2^24 so 3 * |dT| fits in 32 bits
+    	uint32_t absdT = dT < 0 ? -dT : dT;
+    	t2 = wideMul(absdT, 3 * absdT).hi >> 1;
+		off2 = 3 * ((TEMP-2000) * (TEMP-2000)) / 8 ;
+		sens2 = 7 * ((TEMP-2000) * (TEMP-2000)) / 8 ;
+    }
+    
+    // Offset = C2 * 2^18 + C4 * dT / 2^5 - OFF2
+    MS_5803_Wide off;
+    off.hi = (uint32_t)sensorCoeffs[2] >> 14;
+    off.lo = (uint32_t)sensorCoeffs[2] << 18;
+    off = wideAdd(off, wideDivPow2(wideMulSigned(dT, sensorCoeffs[4]), 5));
+    off = wideAdd(off, wideNeg(wideFrom(off2)));
+    // Sensitivity = C1 * 2^17 + C3 * dT / 2^7 - SENS2
+    MS_5803_Wide sens;
+    sens.hi = (uint32_t)sensorCoeffs[1] >> 15;
+    sens.lo = (uint32_t)sensorCoeffs[1] << 17;
+    sens = wideAdd(sens, wideDivPow2(wideMulSigned(dT, sensorCoeffs[3]), 7));
+    sens = wideAdd(sens, wideNeg(wideFrom(sens2)));
+    TEMP = TEMP - t2;
+    
+    // P = (D1 * Sensitivity / 2^21 - Offset) / 2^15. D1 is unsigned, so the 
+    // low 64 bits of the product come from the unsigned product of the low
+    // halves plus D1 times the high half of Sensitivity.
+    MS_5803_Wide p = wideMul(d1Val, sens.lo);
+    p.hi += d1Val * sens.hi;
+    p = wideDivPow2(p, 21);
+    p = wideAdd(p, wideNeg(off));
+    mbarInt = (int32_t)wideDivPow2(p, 15).lo;
+}
+
+//------------------------------------------------------------------
+// Compensates the raw values using 64-bit integer math, as given on page 8 
+// and 9 of the MS5803 data sheet. Sets TEMP and mbarInt.
+void MS_5803::convert64(uint32_t d1Val, uint32_t d2Val) {
     // Calculate 1st order temperature, dT is a long integer
 	// varD2 is originally cast as an uint32_t, but can fit in a int32_t, so we'll
 	// cast both parts of the equation below as signed values so that we can
@@ -203,6 +353,115 @@ void MS_5803::convertRaw(uint32_t d1Val, uint32_t d2Val) {
 
 	// For 5 bar sensor
 	mbarInt = ((d1Val * Sensitivity) / 2097152 - Offset) / 32768;
+}
+
+//------------------------------------------------------------------
+// Compensates the raw values in single precision float, using the 
+// polynomials in dT prepared by prepareCoefficients(). On MCUs with an FPU
+// this is a handful of multiply-adds. Sets TEMP and mbarInt.
+void MS_5803::convertFloat(uint32_t d1Val, uint32_t d2Val) {
+    dT = (int32_t)d2Val - ( (int32_t)sensorCoeffs[5] * 256 );
+    // dT is exact in a float, since |dT| < 2^24
+    float x = (float)dT;
+    float t = x * fTemp1;
+    float temp = t;
+    float sens = fSens0 + x * fSens1;
+    float off = fOff0 + x * fOff1;
+    // 2nd order compensation below 20.0C, with TEMP - 2000 = t. Like the 
+    // integer math, it squares t truncated, which at -40C is worth 2 
+    // (0.01 mbar) at full scale.
+    if (t < 0) {
+    	float t1 = truncf(t);
+    	// t is rounded. Where it rounded onto a whole number the exact 
+    	// value may be above it, and truncates to the next one up.
+    	if (t1 == t && fmaf(x, fTemp1, -t) > 0) {
+    		t1 += 1;
+    	}
+    	temp = t - x * x * fTemp2;
+    	sens -= t1 * t1 * fSens2;
+    	off -= t1 * t1 * fOff2;
+    }
+    // Truncate like the integer path
+    TEMP = 2000 + (int32_t)temp;
+    mbarInt = (int32_t)((float)d1Val * sens - off);
+}
+
+//------------------------------------------------------------------
+// Derives the float coefficients used by convertFloat() from sensorCoeffs.
+// The powers of 2 of the integer compensation are folded into them, giving
+// (with x = dT, t = x * C6 / 2^23):
+//   TEMP - 2000 = t - 3 * x^2 / 2^33
+//   Sensitivity / 2^36 = C1 / 2^19 + x * C3 / 2^43 - t^2 * 7 / 8 / 2^36
+//   Offset / 2^15 = C2 * 8 + x * C4 / 2^20 - t^2 * 3 / 8 / 2^15
+// where the t^2 terms only apply below 20.0C, and the pressure is then
+// D1 * Sensitivity / 2^36 - Offset / 2^15.
+void MS_5803::prepareCoefficients() {
+    fTemp1 = (float)sensorCoeffs[6] / 8388608.0;
+    fTemp2 = 3.0 / 8589934592.0;
+    fSens0 = (float)sensorCoeffs[1] / 524288.0;
+    fSens1 = (float)sensorCoeffs[3] / 8796093022208.0;
+    fSens2 = 7.0 / 8 / 68719476736.0;
+    fOff0 = (float)sensorCoeffs[2] * 8;
+    fOff1 = (float)sensorCoeffs[4] / 1048576.0;
+    fOff2 = 3.0 / 8 / 32768.0;
+}
+
+//------------------------------------------------------------------
+// Compensates the raw values with the temperature side taken from the 
+// lookup table set by setLUT(), falling back to the direct computation out
+// of its range (or for a negative Sensitivity, which no real sensor has).
+// Sets TEMP and mbarInt.
+void MS_5803::convertLUT(uint32_t d1Val, uint32_t d2Val) {
+    dT = (int32_t)d2Val - ( (int32_t)sensorCoeffs[5] * 256 );
+    int64_t off;
+    int64_t sens;
+    if (lut == NULL || !lut->lookup(dT, TEMP, off, sens) || sens < 0) {
+#if MS5803_INT64_FREE
+    	convert32(d1Val, d2Val);
+#else
+    	convert64(d1Val, d2Val);
+#endif
+    	return;
+    }
+    // Sensitivity is positive for any real sensor, so D1 * Sensitivity is 
+    // too and its division by 2^21 is a shift
+    mbarInt = ((((int64_t)d1Val * sens) >> 21) - off) / 32768;
+}
+
+//------------------------------------------------------------------
+// Sets the lookup table used by MS5803_CONVERT_LUT. The table must have
+// been built for this sensor, see MS_5803_LUT::build().
+void MS_5803::setLUT(const MS_5803_LUT *table) {
+    lut = table;
+}
+
+//------------------------------------------------------------------
+// Selects how convertRaw() compensates the raw values: 
+// MS5803_CONVERT_INTEGER (default), MS5803_CONVERT_FLOAT or
+// MS5803_CONVERT_LUT.
+void MS_5803::setConversion(uint8_t conversion) {
+    _conversion = conversion;
+    // The float constants are derived from sensorCoeffs, which may have
+    // been kept across deep sleep without initializeMS_5803() being run
+    if (conversion == MS5803_CONVERT_FLOAT) {
+    	prepareCoefficients();
+    }
+}
+
+void MS_5803::convertRaw(uint32_t d1Val, uint32_t d2Val) {
+    if (_conversion == MS5803_CONVERT_FLOAT) {
+    	convertFloat(d1Val, d2Val);
+    } else if (_conversion == MS5803_CONVERT_LUT) {
+    	convertLUT(d1Val, d2Val);
+    } else {
+#if MS5803_INT64_FREE
+    	convert32(d1Val, d2Val);
+#else
+    	convert64(d1Val, d2Val);
+#endif
+    }
+	// Apply the per-sensor offset and gain correction (see setCalibration())
+	mbarInt = mbarInt + calOffset + ((mbarInt * calGain) >> 20);
     mbar = (float)mbarInt / 100;
     
     // Calculate the human-readable temperature in Celsius
@@ -231,15 +490,15 @@ uint8_t MS_5803::MS_5803_CRC(uint16_t n_prom[]) {
     uint16_t crc_read;	// original value of the CRC
     uint8_t  n_bit;
     n_rem = 0x00;
-    crc_read = sensorCoeffs[7];		// save read CRC
-    sensorCoeffs[7] = (0xFF00 & (sensorCoeffs[7])); // CRC byte replaced with 0
+    crc_read = n_prom[7];		// save read CRC
+    n_prom[7] = (0xFF00 & (n_prom[7])); // CRC byte replaced with 0
     for (cnt = 0; cnt < 16; cnt++)
     { // choose LSB or MSB
         if (cnt%2 == 1) {
-        	n_rem ^= (uint16_t)((sensorCoeffs[cnt>>1]) & 0x00FF);
+        	n_rem ^= (uint16_t)((n_prom[cnt>>1]) & 0x00FF);
         }
         else {
-        	n_rem ^= (uint16_t)(sensorCoeffs[cnt>>1] >> 8);
+        	n_rem ^= (uint16_t)(n_prom[cnt>>1] >> 8);
         }
         for (n_bit = 8; n_bit > 0; n_bit--)
         {
@@ -253,7 +512,7 @@ uint8_t MS_5803::MS_5803_CRC(uint16_t n_prom[]) {
         }
     }
     n_rem = (0x000F & (n_rem >> 12));// // final 4-bit reminder is CRC code
-    sensorCoeffs[7] = crc_read; // restore the crc_read to its original place
+    n_prom[7] = crc_read; // restore the crc_read to its original place
     // Return n_rem so it can be compared to the sensor's CRC value
     return (n_rem ^ 0x00); 
 }
@@ -261,55 +520,365 @@ uint8_t MS_5803::MS_5803_CRC(uint16_t n_prom[]) {
 //-----------------------------------------------------------------
 // Send commands and read the temperature and pressure from the sensor
 uint32_t MS_5803::MS_5803_ADC(char commandADC) {
+    // Send the command to do the ADC conversion on the chip
+    startConversion(commandADC);
+    if (adcFailed) {
+    	return 0;
+    }
+    // Wait a specified period of time for the ADC conversion to happen.
+    // A simulated sensor converts at once, so replays run faster than real
+    // time, and no wait is counted
+    if (simulator == NULL) {
+    	uint8_t wait = convDelayMs[osrIndex(commandADC)];
+    	delay(wait);
+    	counters.waitMs += wait;
+    }
+    return readADC();
+}
+
+//-----------------------------------------------------------------
+// Returns the index into the per-OSR tables for an ADC command. The OSR 
+// bits of the command (CMD_ADC_256..CMD_ADC_4096) are 0, 2, 4, 6 and 8, 
+// so half of them is the index.
+uint8_t MS_5803::osrIndex(char commandADC) {
+    uint8_t osr = (commandADC & 0x0F) >> 1;
+    return osr > 4 ? 4 : osr;
+}
+
+//-----------------------------------------------------------------
+// Returns the ADC command bits for the oversampling resolution.
+char MS_5803::osrCommand() const {
+    for (uint8_t i = 0; i < 5; i++) {
+    	if (_Resolution == (256U << i)) {
+    		return i * 2;
+    	}
+    }
+    return CMD_ADC_512;
+}
+
+//-----------------------------------------------------------------
+// Starts an ADC conversion without waiting for it.
+void MS_5803::startConversion(char commandADC) {
+    adcFailed = !busAcquire();
+    if (adcFailed) {
+    	return;
+    }
+    if (simulator != NULL) {
+    	simResult = simulator->convert(commandADC);
+    	counters.transactions++;
+    	counters.bytes++;
+    } else {
+    	sendCommand(CMD_ADC_CONV + commandADC);
+    }
+    busRelease();
+    counters.conversions[osrIndex(commandADC)]++;
+}
+
+//-----------------------------------------------------------------
+// Reads the result of the last ADC conversion. The conversion must have 
+// had time to finish (see conversionDelay()), or the result is 0. Sets
+// adcFailed if the bus couldn't be acquired.
+uint32_t MS_5803::readADC() {
 	// varD1 and varD2 will come back as 24-bit values, and so they must be stored in 
 	// a long integer on 8-bit Arduinos.
     int32_t result = 0;
-    // Send the command to do the ADC conversion on the chip
-	Wire.beginTransmission(MS5803_I2C_ADDRESS);
-    Wire.write(CMD_ADC_CONV + commandADC);
-    Wire.endTransmission();
-    // Wait a specified period of time for the ADC conversion to happen
-    // See table on page 1 of the MS5803 data sheet showing response times of
-    // 0.5, 1.1, 2.1, 4.1, 8.22 ms for each accuracy level. 
-    switch (commandADC & 0x0F) 
-    {
-        case CMD_ADC_256 :
-            delay(1); // 1 ms
-            break;
-        case CMD_ADC_512 :
-            delay(3); // 3 ms
-            break;
-        case CMD_ADC_1024:
-            delay(4);
-            break;
-        case CMD_ADC_2048:
-            delay(6);
-            break;
-        case CMD_ADC_4096:
-            delay(10);
-            break;
+    if (!busAcquire()) {
+    	adcFailed = true;
+    	return 0;
+    }
+    if (simulator != NULL) {
+    	counters.transactions += 2;
+    	counters.bytes += 4;
+    	busRelease();
+    	return simResult;
     }
     // Now send the read command to the MS5803 
-    Wire.beginTransmission(MS5803_I2C_ADDRESS);
-    Wire.write((byte)CMD_ADC_READ);
-    Wire.endTransmission();
+    sendCommand((byte)CMD_ADC_READ);
     // Then request the results. This should be a 24-bit result (3 bytes)
-    Wire.requestFrom(MS5803_I2C_ADDRESS, 3);
-    while(Wire.available()) {
-    	HighByte = Wire.read();
-    	MidByte = Wire.read();
-    	LowByte = Wire.read();
+    _wire->requestFrom((int)_address, 3);
+    counters.transactions++;
+    counters.bytes += 3;
+    while(_wire->available()) {
+    	HighByte = _wire->read();
+    	MidByte = _wire->read();
+    	LowByte = _wire->read();
     }
+    busRelease();
     // Combine the bytes into one integer
     result = ((uint32_t)HighByte << 16) + ((uint32_t)MidByte << 8) + (uint32_t)LowByte;
     return result;
 }
 
+//-----------------------------------------------------------------
+// Split-phase reading, for interleaving conversions of several sensors.
+// Start a conversion, wait conversionDelay(Resolution) ms (or do other 
+// work), then read its result. Reading the temperature completes the
+// reading and updates pressure() and temperature().
+void MS_5803::startPressure() {
+    startConversion(CMD_ADC_D1 + osrCommand());
+}
+
+void MS_5803::startTemperature() {
+    startConversion(CMD_ADC_D2 + osrCommand());
+}
+
+boolean MS_5803::readPressure() {
+    uint32_t d1 = readADC();
+    if (adcFailed) {
+    	return false;
+    }
+    varD1 = d1;
+    return true;
+}
+
+boolean MS_5803::readTemperature() {
+    uint32_t d2 = readADC();
+    if (adcFailed) {
+    	return false;
+    }
+    varD2 = d2;
+    convertRaw(varD1, varD2);
+    return true;
+}
+
 //----------------------------------------------------------------
 // Sends a power on reset command to the sensor.
 void MS_5803::resetSensor() {
-    	Wire.beginTransmission(MS5803_I2C_ADDRESS);
-        Wire.write(CMD_RESET);
-        Wire.endTransmission();
+    	if (simulator != NULL) {
+    		simulator->reset();
+    		counters.transactions++;
+    		counters.bytes++;
+    		return;
+    	}
+    	if (busAcquire()) {
+    		sendCommand(CMD_RESET);
+    		busRelease();
+    	}
     	delay(5);
+    	counters.waitMs += 5;
+}
+
+//----------------------------------------------------------------
+// Reads one 16-bit word of the sensor's PROM (0-7), or 0 if the bus
+// couldn't be acquired.
+uint16_t MS_5803::readPROM(uint8_t index) {
+    if (simulator != NULL) {
+    	counters.transactions += 2;
+    	counters.bytes += 3;
+    	return simulator->prom(index);
+    }
+    if (!busAcquire()) {
+    	return 0;
+    }
+    // The PROM starts at address 0xA0
+    sendCommand(0xA0 + (index * 2));
+    _wire->requestFrom((int)_address, 2);
+    counters.transactions++;
+    counters.bytes += 2;
+    while(_wire->available()) {
+    	HighByte = _wire->read();
+    	LowByte = _wire->read();
+    }
+    busRelease();
+    return (((uint16_t)HighByte << 8) + LowByte);
+}
+
+//----------------------------------------------------------------
+// Takes the bus for one exchange with the sensor, through the arbiter if
+// one is set. Returns false if the arbiter timed out.
+boolean MS_5803::busAcquire() {
+    if (arbiter == NULL) {
+    	return true;
+    }
+    if (arbiter->acquire(_priority, _busTimeoutUs)) {
+    	return true;
+    }
+    counters.busTimeouts++;
+    return false;
+}
+
+void MS_5803::busRelease() {
+    if (arbiter != NULL) {
+    	arbiter->release();
+    }
+}
+
+//----------------------------------------------------------------
+// Shares the bus with other clients through an arbiter. The sensor takes
+// the bus with the given priority for each exchange, waiting at most
+// timeoutUs for it.
+void MS_5803::setArbiter(MS_5803_BusArbiter *busArbiter, uint8_t priority,
+                         uint32_t timeoutUs) {
+    arbiter = busArbiter;
+    _priority = priority;
+    _busTimeoutUs = timeoutUs;
+}
+
+//----------------------------------------------------------------
+// Replaces the sensor with a simulated one (see MS5803_Sim.h), or goes 
+// back to the real sensor when given NULL.
+void MS_5803::setSimulator(MS_5803_SimDevice *device) {
+    simulator = device;
+    simResult = 0;
+    adcFailed = false;
+}
+
+//----------------------------------------------------------------
+// I2C clocks tried by negotiateClock(), slowest first
+static const uint32_t busClocks[MS5803_CLOCK_STEPS] = {100000, 400000, 1000000};
+
+//----------------------------------------------------------------
+// Steps the bus through 100 kHz, 400 kHz and 1 MHz. At each clock the PROM
+// is read back and compared with the coefficients from 
+// initializeMS_5803(), and 'reads' readings are taken and checked against
+// one taken at 100 kHz (within 10 mbar and 2 C). The fastest clock with no
+// errors, lowered by 'margin' steps, is set and kept in the object so it
+// persists across deep sleep (see keptHash()). Returns that clock, or 0 if
+// the coefficients fail their CRC or 100 kHz itself has errors, in which
+// case the bus is left at 100 kHz.
+uint32_t MS_5803::negotiateClock(uint8_t reads, uint8_t margin) {
+    _busClock = 0;
+    for (uint8_t i = 0; i < MS5803_CLOCK_STEPS; i++) {
+    	clockLatency[i] = 0;
+    }
+    if ((uint8_t)sensorCoeffs[7] != MS_5803_CRC(sensorCoeffs)) {
+    	_wire->setClock(busClocks[0]);
+    	keep();
+    	return 0;
+    }
+    int32_t refPressure = 0;
+    int32_t refTemp = 0;
+    int8_t best = -1;
+    for (uint8_t step = 0; step < MS5803_CLOCK_STEPS; step++) {
+    	_wire->setClock(busClocks[step]);
+    	uint16_t errors = 0;
+    	for (uint8_t i = 0; i < 8; i++) {
+    		if (readPROM(i) != sensorCoeffs[i]) {
+    			errors++;
+    		}
+    	}
+    	uint32_t latency = 0;
+    	for (uint8_t r = 0; r < reads; r++) {
+    		startPressure();
+    		delay(conversionDelay(_Resolution));
+    		unsigned long start = micros();
+    		readPressure();
+    		latency += micros() - start;
+    		startTemperature();
+    		delay(conversionDelay(_Resolution));
+    		readTemperature();
+    		if (step == 0 && r == 0) {
+    			refPressure = mbarInt;
+    			refTemp = TEMP;
+    		}
+    		// A corrupted transfer shows up as an implausible jump
+    		if (varD1 == 0 || varD2 == 0 || abs(mbarInt - refPressure) > 1000 
+    				|| abs(TEMP - refTemp) > 200) {
+    			errors++;
+    		}
+    	}
+    	clockLatency[step] = reads ? latency / reads : 0;
+    	if (errors) {
+    		break;
+    	}
+    	best = step;
+    }
+    if (best < 0) {
+    	_wire->setClock(busClocks[0]);
+    	keep();
+    	return 0;
+    }
+    best = max(0, best - margin);
+    _busClock = busClocks[best];
+    _wire->setClock(_busClock);
+    keep();
+    return _busClock;
+}
+
+//----------------------------------------------------------------
+// Average time (us) to read one conversion result at each clock step of
+// the last negotiateClock(), 0 if the step wasn't tried.
+uint32_t MS_5803::readLatency(uint8_t step) const {
+    return step < MS5803_CLOCK_STEPS ? clockLatency[step] : 0;
+}
+
+//----------------------------------------------------------------
+// Sends a single command byte to the sensor. The caller holds the bus.
+void MS_5803::sendCommand(byte command) {
+    _wire->beginTransmission(_address);
+    _wire->write(command);
+    _wire->endTransmission();
+    counters.transactions++;
+    counters.bytes++;
+}
+
+//----------------------------------------------------------------
+// Returns the time in ms the driver waits for one ADC conversion at the
+// given oversampling resolution, or 0 for an invalid resolution.
+uint8_t MS_5803::conversionDelay(uint16_t Resolution) {
+    for (uint8_t i = 0; i < 5; i++) {
+    	if (Resolution == (256U << i)) {
+    		return convDelayMs[i];
+    	}
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------
+float MS_5803::pressureNoise(uint16_t Resolution) {
+    for (uint8_t i = 0; i < 5; i++) {
+    	if (Resolution == (256U << i)) {
+    		return noiseMbar[i];
+    	}
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------
+// Sets the correction applied to the compensated pressure. The offset is in
+// units of 0.01 mbar. The gain is the deviation from 1 in units of 2^-20 and
+// is limited to +/-2047 (about 0.2%) so that the correction can be done in
+// 32-bit integer math for any pressure the 5 bar sensor can report.
+void MS_5803::setCalibration(int32_t offset, int16_t gain) {
+    if (gain > MS5803_CAL_GAIN_MAX) {
+    	gain = MS5803_CAL_GAIN_MAX;
+    } else if (gain < -MS5803_CAL_GAIN_MAX) {
+    	gain = -MS5803_CAL_GAIN_MAX;
+    }
+    calOffset = offset;
+    calGain = gain;
+    keep();
+}
+
+//----------------------------------------------------------------
+// FNV-1a hash of 'length' bytes, continuing from 'hash'
+static uint32_t hashBytes(uint32_t hash, const void *data, uint8_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (uint8_t i = 0; i < length; i++) {
+    	hash = (hash ^ bytes[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+//----------------------------------------------------------------
+// Hash of the settings the constructor keeps: the calibration, the bus
+// clock and the latencies. Memory that was never written, or held 
+// something else, matches it only by chance.
+uint32_t MS_5803::keptHash() const {
+    uint32_t hash = hashBytes(2166136261UL, &calOffset, sizeof(calOffset));
+    hash = hashBytes(hash, &calGain, sizeof(calGain));
+    hash = hashBytes(hash, &_busClock, sizeof(_busClock));
+    return hashBytes(hash, clockLatency, sizeof(clockLatency));
+}
+
+//----------------------------------------------------------------
+// Stores the check value after the kept settings change.
+void MS_5803::keep() {
+    keptCheck = keptHash();
+}
+
+//----------------------------------------------------------------
+// Clears the bus and conversion activity counters.
+void MS_5803::resetActivity() {
+    memset(&counters, 0, sizeof(counters));
 }
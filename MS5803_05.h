@@ -45,10 +45,46 @@
 #define CMD_ADC_2048	0x06	// ADC resolution=2048
 #define CMD_ADC_4096	0x08	// ADC resolution=4096
 
+// Set to 1 to compensate readings without 64-bit integer math. The results
+// are identical, but on 8-bit AVRs it is much faster, so it is the default
+// there.
+#ifndef MS5803_INT64_FREE
+#if defined(__AVR__)
+#define MS5803_INT64_FREE	1
+#else
+#define MS5803_INT64_FREE	0
+#endif
+#endif
+
+// Conversion methods, see setConversion()
+#define MS5803_CONVERT_INTEGER	0	// Integer math from the data sheet
+#define MS5803_CONVERT_FLOAT	1	// Single precision float, for MCUs with FPU
+#define MS5803_CONVERT_LUT		2	// Integer math with a temperature lookup table
+
+#define MS5803_CLOCK_STEPS	3	// I2C clocks tried by negotiateClock()
+
+#define MS5803_CAL_GAIN_MAX	2047	// Largest calibration gain, in 2^-20 units
+
 #ifndef __MS_5803__
 #define __MS_5803__
 
 #include <Arduino.h>
+#include <Wire.h>
+
+class MS_5803_LUT;
+class MS_5803_BusArbiter;
+class MS_5803_SimDevice;
+
+// Counts of the bus and conversion activity of one MS_5803, kept so that the
+// energy model (MS5803_Energy.h) can account for what the driver really did.
+struct MS_5803_Counters {
+    uint32_t conversions[5]; // ADC conversions started, per OSR 256..4096
+    uint32_t transactions;   // I2C transactions (command writes and reads)
+    uint32_t bytes;          // data bytes moved on the bus, excluding address
+    uint32_t waitMs;         // time spent waiting on reset and conversions
+                             // (none for a simulated sensor)
+    uint32_t busTimeouts;    // exchanges skipped as the bus wasn't granted
+};
 
 class MS_5803 {
 public:
@@ -58,16 +94,68 @@ public:
 	// for example MS5803-14BA or MS5803-01BA would be 14 and 1 bar units.
 	// The 2nd argument is the desired oversampling resolution, which has 
 	// values of 256, 512, 1024, 2048, 4096
-    MS_5803(uint16_t Resolution = 512);
+	// The optional 3rd and 4th arguments are the sensor's I2C address 
+	// (0x76 or 0x77) and the I2C bus it is on, for using several sensors.
+    MS_5803(uint16_t Resolution = 512, uint8_t Address = MS5803_I2C_ADDRESS,
+            TwoWire &Bus = Wire);
     // Initialize the sensor 
     boolean initializeMS_5803(boolean Verbose = true);
     // Reset the sensor
     void resetSensor();
-    // Read the sensor
-    void readSensor();
+    // Read the sensor. Returns false, keeping the previous reading, if the
+    // bus couldn't be acquired (see setArbiter()).
+    boolean readSensor();
+    // Read the sensor in steps, without waiting: start the pressure (D1) 
+    // conversion, read it after conversionDelay() ms, start the temperature
+    // (D2) conversion, then read it. readTemperature() completes the reading.
+    // The reads return false, keeping the previous values, if the bus 
+    // couldn't be acquired for the conversion or the read.
+    void startPressure();
+    boolean readPressure();
+    void startTemperature();
+    boolean readTemperature();
     // Utility method for converting raw D1 and D2 values (get output using
     // pressure() and temperature() methods).
     void convertRaw(uint32_t d1Val, uint32_t d2Val);
+    // Choose how convertRaw() compensates the raw values. The default, 
+    // MS5803_CONVERT_INTEGER, follows the data sheet exactly. 
+    // MS5803_CONVERT_FLOAT is faster on MCUs with an FPU (ESP32, Cortex-M4F)
+    // and stays within 2 (0.01 mbar) of pressureInt() and 1 (0.01 C) of 
+    // temperatureInt() from the integer math, from -40 to 85C and 0 to 6 bar.
+    // MS5803_CONVERT_LUT gives the same results as the integer math, but 
+    // takes the temperature side from a table (see setLUT()).
+    void setConversion(uint8_t conversion);
+    // Talk to a simulated sensor instead of the bus (see MS5803_Sim.h), or
+    // to the real one again with NULL. Conversions don't wait. Conversions
+    // and reads still go through the arbiter, if one is set, so its waits
+    // can be measured without a sensor.
+    void setSimulator(MS_5803_SimDevice *device);
+    // Find the fastest I2C clock (100 kHz, 400 kHz or 1 MHz) at which the 
+    // PROM and 'reads' readings come back without errors, less 'margin' 
+    // steps, and use it from then on. Call after initializeMS_5803(). 
+    // Returns the clock, or 0 if even 100 kHz had errors.
+    uint32_t negotiateClock(uint8_t reads = 10, uint8_t margin = 0);
+    // Clock chosen by negotiateClock(), 0 if it hasn't been run. Like the
+    // calibration (see setCalibration()), the constructor keeps the clock
+    // and the latencies when the object is in RTC memory across deep 
+    // sleep, and clears them otherwise.
+    uint32_t busClock() const       {return _busClock;}
+    // Average time (us) to read a result at clock step 0-2 (100 kHz, 
+    // 400 kHz, 1 MHz) measured by negotiateClock(), 0 if not tried
+    uint32_t readLatency(uint8_t step) const;
+    // Share the bus with other I2C clients through an arbiter (see 
+    // MS5803_Bus.h). Each exchange with the sensor waits at most timeoutUs
+    // for the bus at the given priority, and is skipped if it isn't granted.
+    void setArbiter(MS_5803_BusArbiter *busArbiter, uint8_t priority = 0,
+                    uint32_t timeoutUs = 20000);
+    // Set the lookup table used by MS5803_CONVERT_LUT (see MS5803_LUT.h)
+    void setLUT(const MS_5803_LUT *table);
+    // Derive the per-device constants used in the conversion from 
+    // sensorCoeffs. initializeMS_5803() and choosing MS5803_CONVERT_FLOAT 
+    // call this; call it yourself if you change sensorCoeffs another way
+    // afterwards. The constructor leaves sensorCoeffs and these constants
+    // alone, so they persist in RTC memory across deep sleep.
+    void prepareCoefficients();
     //*********************************************************************
     // Additional methods to extract temperature, pressure (mbar), and the 
     // varD1,varD2 values after readSensor() has been called
@@ -86,13 +174,43 @@ public:
 //    float inHg() const				{return inHgPress;}
 //    // Return pressure in mmHg
 //    float mmHg() const				{return mmHgPress;}
+    // Return temperature in hundredths of a degree Celsius.
+    int32_t temperatureInt() const  {return TEMP;}
+    // Return pressure in hundredths of a mbar, after calibration.
+    int32_t pressureInt() const     {return mbarInt;}
     // Return the varD1 and varD2 values, mostly for troubleshooting
     uint32_t D1val() const 	{return varD1;}
     uint32_t D2val() const		{return varD2;}
+    // Set the offset (0.01 mbar) and gain (deviation from 1, in units of
+    // 2^-20) applied to the pressure. They are stored with a check value,
+    // so the constructor keeps them when the object is in RTC memory across
+    // deep sleep, and clears them otherwise. See MS5803_Calibration.h for
+    // estimating them.
+    void setCalibration(int32_t offset, int16_t gain);
+    int32_t calibrationOffset() const {return calOffset;}
+    int16_t calibrationGain() const   {return calGain;}
+    // Return the bus and conversion activity since construction or the last
+    // call to resetActivity().
+    const MS_5803_Counters &activity() const {return counters;}
+    void resetActivity();
+    // Return the time in ms waited for one ADC conversion at the given
+    // oversampling resolution (0 for an invalid resolution).
+    static uint8_t conversionDelay(uint16_t Resolution);
+    // Return the typical RMS noise in mbar of the pressure at the given 
+    // oversampling resolution (0 for an invalid resolution), from the 
+    // resolution table of the data sheet.
+    static float pressureNoise(uint16_t Resolution);
+    // Return the oversampling resolution the sensor was created with
+    uint16_t resolution() const     {return _Resolution;}
     
     uint16_t sensorCoeffs[8]; // unsigned 16-bit integer (0-65535)
+    // Check data integrity with CRC4. Returns the CRC of the 8 PROM words,
+    // to compare with the low byte of word 7.
+    static uint8_t MS_5803_CRC(uint16_t n_prom[]); 
     
 private:
+    // Submits the bus operations of several sensors at once
+    friend class MS_5803_CommandList;
     
     float mbar; // Store pressure in mbar. 
     float tempC; // Store temperature in degrees Celsius
@@ -104,12 +222,64 @@ private:
     uint32_t varD1;	// Store varD1 value
     uint32_t varD2;	// Store varD2 value
     int32_t mbarInt; // pressure in mbar, initially as a signed long integer
-    // Check data integrity with CRC4
-    uint8_t MS_5803_CRC(uint16_t n_prom[]); 
     // Handles commands to the sensor.
     uint32_t MS_5803_ADC(char commandADC);
+    // Set when the bus couldn't be acquired for the pending conversion or
+    // its read, so its result is not valid
+    boolean adcFailed;
+    // Compensation of the raw values with and without 64-bit integer math.
+    // Both set TEMP and mbarInt.
+    void convert64(uint32_t d1Val, uint32_t d2Val);
+    void convert32(uint32_t d1Val, uint32_t d2Val);
+    void convertFloat(uint32_t d1Val, uint32_t d2Val);
+    void convertLUT(uint32_t d1Val, uint32_t d2Val);
+    // Split-phase ADC access, see MS_5803_ADC()
+    void startConversion(char commandADC);
+    uint32_t readADC();
+    static uint8_t osrIndex(char commandADC);
+    char osrCommand() const;
+    uint16_t readPROM(uint8_t index);
+    boolean busAcquire();
+    void busRelease();
+    // Sends a single command byte to the sensor.
+    void sendCommand(byte command);
     // Oversampling resolution
     uint16_t _Resolution;
+    // I2C address and bus of the sensor
+    uint8_t _address;
+    TwoWire *_wire;
+    // Bus arbiter, priority and timeout, see setArbiter()
+    MS_5803_BusArbiter *arbiter;
+    uint8_t _priority;
+    uint32_t _busTimeoutUs;
+    // Simulated sensor and its pending conversion, see setSimulator()
+    MS_5803_SimDevice *simulator;
+    uint32_t simResult;
+    // Negotiated bus clock and read latency at each step tried
+    uint32_t _busClock;
+    uint32_t clockLatency[MS5803_CLOCK_STEPS];
+    // Conversion method, see setConversion()
+    uint8_t _conversion;
+    // Temperature lookup table, see setLUT()
+    const MS_5803_LUT *lut;
+    // Float coefficients of the conversion, see prepareCoefficients()
+    float fTemp1;
+    float fTemp2;
+    float fSens0;
+    float fSens1;
+    float fSens2;
+    float fOff0;
+    float fOff1;
+    float fOff2;
+    // Pressure correction, see setCalibration()
+    int32_t calOffset;
+    int16_t calGain;
+    // Check value of the settings kept across deep sleep, see keep()
+    uint32_t keptCheck;
+    uint32_t keptHash() const;
+    void keep();
+    // Bus and conversion activity counters
+    MS_5803_Counters counters;
 
     // Create array to hold the 8 sensor calibration coefficients
     
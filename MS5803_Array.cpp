@@ -0,0 +1,165 @@
+/*
+ *  MS5803_Array
+ *  	Windowed aggregation across an array of MS5803 sensors. See 
+ *  	MS5803_Array.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Array.h"
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Array::MS_5803_Array(uint16_t sensors, uint16_t pairs,
+                             uint32_t windowMs) {
+    _sensors = sensors;
+    _pairs = pairs;
+    _windowMs = windowMs > 0 ? windowMs : 1;
+    current = 0;
+    start = 0;
+    started = false;
+    open = false;
+    _dropped = 0;
+    sums = new int64_t[sensors];
+    counts = new uint16_t[sensors];
+    pairA = new uint16_t[pairs];
+    pairB = new uint16_t[pairs];
+    pairDistance = new float[pairs];
+    gradients = new float[pairs];
+    for (uint16_t i = 0; i < sensors; i++) {
+    	sums[i] = 0;
+    	counts[i] = 0;
+    }
+    for (uint16_t i = 0; i < pairs; i++) {
+    	pairA[i] = 0;
+    	pairB[i] = 0;
+    	pairDistance[i] = 1;
+    	gradients[i] = NAN;
+    }
+    memset(&last, 0, sizeof(last));
+}
+
+//-------------------------------------------------
+// Destructor
+MS_5803_Array::~MS_5803_Array() {
+    delete[] sums;
+    delete[] counts;
+    delete[] pairA;
+    delete[] pairB;
+    delete[] pairDistance;
+    delete[] gradients;
+}
+
+//-------------------------------------------------
+void MS_5803_Array::setPair(uint16_t index, uint16_t a, uint16_t b,
+                            float distance) {
+    if (index >= _pairs || a >= _sensors || b >= _sensors || distance == 0) {
+    	return;
+    }
+    pairA[index] = a;
+    pairB[index] = b;
+    pairDistance[index] = distance;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Array::add(uint16_t sensor, uint32_t ms, int32_t pressure) {
+    if (sensor >= _sensors) {
+    	return false;
+    }
+    boolean closed = false;
+    if (!started) {
+    	// The first window is aligned to the window length
+    	current = ms / _windowMs;
+    	start = ms - ms % _windowMs;
+    	started = true;
+    } else {
+    	// Compare times as signed differences, so windows carry on across
+    	// the wrap of millis() after 49.7 days
+    	int32_t elapsed = (int32_t)(ms - start);
+    	if (elapsed < 0) {
+    		_dropped++;
+    		return false;
+    	}
+    	uint32_t windows = (uint32_t)elapsed / _windowMs;
+    	if (windows > 0) {
+    		if (open) {
+    			close();
+    			closed = true;
+    		}
+    		current += windows;
+    		start += windows * _windowMs;
+    	}
+    }
+    open = true;
+    // Keep the count from wrapping on very long windows
+    if (counts[sensor] < 0xFFFF) {
+    	sums[sensor] += pressure;
+    	counts[sensor]++;
+    }
+    return closed;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Array::flush() {
+    if (!open) {
+    	return false;
+    }
+    close();
+    open = false;
+    return true;
+}
+
+//-------------------------------------------------
+float MS_5803_Array::gradient(uint16_t index) const {
+    if (index >= _pairs) {
+    	return NAN;
+    }
+    return gradients[index];
+}
+
+//-------------------------------------------------
+// Computes the aggregates of the current window and clears its sums.
+// The per-sensor means are written back into 'sums' scaled by 256 so the
+// deviation and gradient passes don't divide again.
+void MS_5803_Array::close() {
+    double total = 0;
+    uint16_t active = 0;
+    for (uint16_t i = 0; i < _sensors; i++) {
+    	if (counts[i]) {
+    		total += (double)sums[i] / counts[i];
+    		active++;
+    	}
+    }
+    last.window = current;
+    last.sensors = active;
+    last.mean = active ? total / active : 0;
+    last.maxDeviation = 0;
+    last.maxDeviationSensor = 0;
+    for (uint16_t i = 0; i < _sensors; i++) {
+    	if (counts[i]) {
+    		sums[i] = (sums[i] * 256) / counts[i];
+    		float dev = fabs(sums[i] / 256.0 - last.mean);
+    		if (dev > last.maxDeviation) {
+    			last.maxDeviation = dev;
+    			last.maxDeviationSensor = i;
+    		}
+    	}
+    }
+    for (uint16_t i = 0; i < _pairs; i++) {
+    	uint16_t a = pairA[i];
+    	uint16_t b = pairB[i];
+    	if (counts[a] && counts[b]) {
+    		gradients[i] = (sums[b] - sums[a]) / 256.0 / pairDistance[i];
+    	} else {
+    		gradients[i] = NAN;
+    	}
+    }
+    for (uint16_t i = 0; i < _sensors; i++) {
+    	sums[i] = 0;
+    	counts[i] = 0;
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ *  MS5803_Array
+ *  	Windowed aggregation of readings from an array of MS5803 sensors. 
+ *  	Timestamped readings from any number of sensors are collected into 
+ *  	fixed time windows; when a window closes the per-sensor means are
+ *  	combined into the spatial mean of the array, the largest deviation of
+ *  	any sensor from that mean, and the gradient between configured pairs
+ *  	of sensors.
+ *
+ *  	Adding a reading is O(1) and closing a window is linear in the number
+ *  	of sensors and pairs. Readings that arrive after their window has 
+ *  	closed are dropped and counted. Times are compared as differences, so
+ *  	aggregation carries on across the wrap of millis() every 49.7 days.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_ARRAY__
+#define __MS_5803_ARRAY__
+
+#include <Arduino.h>
+
+// Aggregates of one closed window
+struct MS_5803_ArrayWindow {
+    uint32_t window;       // window number (timestamp / window length,
+                           // counted on across the wrap of millis())
+    uint16_t sensors;      // sensors with at least one reading in the window
+    float mean;            // spatial mean of the per-sensor means, 0.01 mbar
+    float maxDeviation;    // largest |sensor mean - spatial mean|, 0.01 mbar
+    uint16_t maxDeviationSensor; // sensor with the largest deviation
+};
+
+class MS_5803_Array {
+public:
+    // Number of sensors and pairs, and the window length in ms
+    MS_5803_Array(uint16_t sensors, uint16_t pairs, uint32_t windowMs);
+    ~MS_5803_Array();
+    // Owns its buffers, so it can't be copied
+    MS_5803_Array(const MS_5803_Array &) = delete;
+    MS_5803_Array &operator=(const MS_5803_Array &) = delete;
+    // Define pair 'index' as sensors a and b, 'distance' apart (e.g. in m).
+    // Its gradient is (mean of b - mean of a) / distance.
+    void setPair(uint16_t index, uint16_t a, uint16_t b, float distance);
+    // Add a reading (0.01 mbar) of one sensor taken at time 'ms'. Returns 
+    // true if it closed the previous window, whose aggregates are then 
+    // available from result() and gradient().
+    boolean add(uint16_t sensor, uint32_t ms, int32_t pressure);
+    // Close the current window without waiting for a later reading
+    boolean flush();
+    // Aggregates of the last closed window
+    const MS_5803_ArrayWindow &result() const {return last;}
+    // Gradient of pair 'index' in the last closed window (NAN if either 
+    // sensor had no readings)
+    float gradient(uint16_t index) const;
+    // Readings dropped because their window had already closed
+    uint32_t dropped() const        {return _dropped;}
+
+private:
+    uint16_t _sensors;
+    uint16_t _pairs;
+    uint32_t _windowMs;
+    // Window currently being collected, the time it started, whether 
+    // there has been a reading yet, and whether the window has any
+    uint32_t current;
+    uint32_t start;
+    boolean started;
+    boolean open;
+    uint32_t _dropped;
+    // Per-sensor sums and counts for the current window
+    int64_t *sums;
+    uint16_t *counts;
+    // Pair definitions and their gradients in the last closed window
+    uint16_t *pairA;
+    uint16_t *pairB;
+    float *pairDistance;
+    float *gradients;
+    MS_5803_ArrayWindow last;
+    void close();
+};
+
+#endif
@@ -0,0 +1,344 @@
+/*
+ *  MS5803_Arrow
+ *  	Arrow IPC stream writer for readings. See MS5803_Arrow.h.
+ *
+ *  	The message metadata are FlatBuffers, built here by hand from the 
+ *  	Arrow schema files (Schema.fbs, Message.fbs): a table is preceded by 
+ *  	its vtable, and everything a table refers to comes after it, since 
+ *  	references are unsigned offsets forward.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Arrow.h"
+
+// Size of the buffer the metadata of a message is built in
+#define METADATA_SIZE 1024
+// Alignment of the column buffers in a record batch
+#define BUFFER_ALIGN 64
+#define COLUMNS 7
+// Values from the Arrow format
+#define METADATA_V5 4
+#define HEADER_SCHEMA 1
+#define HEADER_RECORD_BATCH 3
+#define TYPE_INT 2
+
+// Name, bit width and signedness of each column
+static const char *const columnNames[COLUMNS] = 
+		{"ms", "sensor", "pressure", "temperature", "d1", "d2", "flags"};
+static const uint8_t columnBits[COLUMNS] = {32, 8, 32, 32, 32, 32, 8};
+static const boolean columnSigned[COLUMNS] = 
+		{false, false, true, true, false, false, false};
+
+// A FlatBuffer built front to back
+struct Flat {
+    uint8_t *buf;
+    uint16_t pos;
+    uint16_t cap;
+    
+    void put(const void *data, uint16_t length) {
+    	if (pos + length <= cap) {
+    		memcpy(buf + pos, data, length);
+    	}
+    	pos += length;
+    }
+    void zero(uint16_t length) {
+    	while (length--) {
+    		uint8_t z = 0;
+    		put(&z, 1);
+    	}
+    }
+    // Pad until pos % size == phase
+    void align(uint8_t size, uint8_t phase = 0) {
+    	while (pos % size != phase) {
+    		zero(1);
+    	}
+    }
+    void u16(uint16_t v)            {put(&v, 2);}
+    void u32(uint32_t v)            {put(&v, 4);}
+    // Point the offset at 'at' to 'target'
+    void link(uint16_t at, uint16_t target) {
+    	if (at + 4 <= cap) {
+    		uint32_t v = target - at;
+    		memcpy(buf + at, &v, 4);
+    	}
+    }
+    // A vector of 'count' offsets, to be linked; returns its position
+    uint16_t offsets(uint8_t count) {
+    	align(4);
+    	uint16_t at = pos;
+    	u32(count);
+    	zero(4 * count);
+    	return at;
+    }
+    // A vector of 16-byte structs (two int64 each)
+    uint16_t structs(const int64_t *values, uint8_t count) {
+    	align(8, 4);
+    	uint16_t at = pos;
+    	u32(count);
+    	put(values, 16 * count);
+    	return at;
+    }
+    uint16_t string(const char *s) {
+    	align(4);
+    	uint16_t at = pos;
+    	uint32_t length = strlen(s);
+    	u32(length);
+    	put(s, length);
+    	zero(1);
+    	return at;
+    }
+};
+
+// One field of a table: its id in the schema, size in bytes, and value. 
+// Offsets to other objects have size 0 and are linked afterwards.
+struct FlatField {
+    uint8_t id;
+    uint8_t size;
+    int64_t value;
+};
+
+// Write a table of 'count' fields with its vtable. Returns the position of
+// the table; the positions of its offset fields are put in 'slots'.
+static uint16_t flatTable(Flat &f, const FlatField *fields, uint8_t count, 
+                          uint16_t *slots) {
+    uint8_t maxId = 0;
+    boolean wide = false;
+    for (uint8_t i = 0; i < count; i++) {
+    	maxId = max(maxId, fields[i].id);
+    	wide |= fields[i].size == 8;
+    }
+    // Lay the fields out largest first after the vtable offset, so that 
+    // each is aligned to its size
+    uint8_t place[8];
+    uint8_t at = 4;
+    for (uint8_t size = 8; size > 0; size >>= 1) {
+    	for (uint8_t i = 0; i < count; i++) {
+    		uint8_t bytes = fields[i].size ? fields[i].size : 4;
+    		if (bytes == size) {
+    			place[i] = at;
+    			at += size;
+    		}
+    	}
+    }
+    f.align(2);
+    uint16_t vtable = f.pos;
+    f.u16(4 + 2 * (maxId + 1));
+    f.u16(at);
+    for (uint8_t id = 0; id <= maxId; id++) {
+    	uint16_t offset = 0;
+    	for (uint8_t i = 0; i < count; i++) {
+    		if (fields[i].id == id) {
+    			offset = place[i];
+    		}
+    	}
+    	f.u16(offset);
+    }
+    f.align(wide ? 8 : 4, wide ? 4 : 0);
+    uint16_t table = f.pos;
+    f.u32(table - vtable);
+    f.zero(at - 4);
+    for (uint8_t i = 0; i < count; i++) {
+    	uint16_t p = table + place[i];
+    	if (fields[i].size == 0) {
+    		slots[i] = p;
+    	}
+    	else if (p + fields[i].size <= f.cap) {
+    		memcpy(f.buf + p, &fields[i].value, fields[i].size);
+    	}
+    }
+    return table;
+}
+
+//-------------------------------------------------
+// Constructor
+MS_5803_ArrowWriter::MS_5803_ArrowWriter(Print &out, uint16_t batchRows) {
+    _out = &out;
+    _index = NULL;
+    capacity = batchRows ? batchRows : 1;
+    rows = 0;
+    _batches = 0;
+    _bytes = 0;
+    ms = new uint32_t[capacity];
+    sensors = new uint8_t[capacity];
+    pressures = new int32_t[capacity];
+    temperatures = new int32_t[capacity];
+    d1s = new uint32_t[capacity];
+    d2s = new uint32_t[capacity];
+    flagValues = new uint8_t[capacity];
+}
+
+MS_5803_ArrowWriter::~MS_5803_ArrowWriter() {
+    delete[] ms;
+    delete[] sensors;
+    delete[] pressures;
+    delete[] temperatures;
+    delete[] d1s;
+    delete[] d2s;
+    delete[] flagValues;
+}
+
+//-------------------------------------------------
+void MS_5803_ArrowWriter::begin() {
+    uint8_t *metadata = new uint8_t[METADATA_SIZE];
+    Flat f = {metadata, 0, METADATA_SIZE};
+    uint16_t slot[3];
+    uint16_t root = f.pos;
+    f.u32(0);
+    FlatField message[4] = {{0, 2, METADATA_V5}, {1, 1, HEADER_SCHEMA}, 
+                            {2, 0, 0}, {3, 8, 0}};
+    f.link(root, flatTable(f, message, 4, slot));
+    uint16_t header = slot[2];
+    FlatField schema[2] = {{0, 2, 0}, {1, 0, 0}};
+    f.link(header, flatTable(f, schema, 2, slot));
+    uint16_t fields = f.offsets(COLUMNS);
+    f.link(slot[1], fields);
+    for (uint8_t i = 0; i < COLUMNS; i++) {
+    	FlatField field[5] = {{0, 0, 0}, {1, 1, 0}, {2, 1, TYPE_INT}, 
+    	                      {3, 0, 0}, {5, 0, 0}};
+    	uint16_t fieldSlot[5];
+    	f.link(fields + 4 + 4 * i, flatTable(f, field, 5, fieldSlot));
+    	f.link(fieldSlot[0], f.string(columnNames[i]));
+    	FlatField type[2] = {{0, 4, columnBits[i]}, {1, 1, columnSigned[i]}};
+    	f.link(fieldSlot[3], flatTable(f, type, 2, slot));
+    	f.link(fieldSlot[4], f.offsets(0));
+    }
+    if (f.pos <= f.cap) {
+    	writeMessage(metadata, f.pos);
+    }
+    delete[] metadata;
+}
+
+//-------------------------------------------------
+void MS_5803_ArrowWriter::add(uint32_t time, uint8_t sensor, int32_t pressure,
+                              int32_t temperature, uint32_t d1, uint32_t d2, 
+                              uint8_t flags) {
+    ms[rows] = time;
+    sensors[rows] = sensor;
+    pressures[rows] = pressure;
+    temperatures[rows] = temperature;
+    d1s[rows] = d1;
+    d2s[rows] = d2;
+    flagValues[rows] = flags;
+    uint32_t bit = 1UL << min(sensor, (uint8_t)31);
+    if (rows == 0) {
+    	stats.msMin = stats.msMax = time;
+    	stats.sensors = bit;
+    	stats.pressureMin = stats.pressureMax = pressure;
+    	stats.temperatureMin = stats.temperatureMax = temperature;
+    } else {
+    	stats.msMin = min(stats.msMin, time);
+    	stats.msMax = max(stats.msMax, time);
+    	stats.sensors |= bit;
+    	stats.pressureMin = min(stats.pressureMin, pressure);
+    	stats.pressureMax = max(stats.pressureMax, pressure);
+    	stats.temperatureMin = min(stats.temperatureMin, temperature);
+    	stats.temperatureMax = max(stats.temperatureMax, temperature);
+    }
+    if (++rows == capacity) {
+    	flush();
+    }
+}
+
+//-------------------------------------------------
+void MS_5803_ArrowWriter::flush() {
+    if (rows == 0) {
+    	return;
+    }
+    const void *columns[COLUMNS] = {ms, sensors, pressures, temperatures, 
+                                    d1s, d2s, flagValues};
+    // Field nodes (length, null count) and buffers (offset, length): no 
+    // validity bitmap, as there are no nulls, then the values
+    int64_t nodes[2 * COLUMNS];
+    int64_t buffers[4 * COLUMNS];
+    int64_t body = 0;
+    for (uint8_t i = 0; i < COLUMNS; i++) {
+    	int64_t length = (int64_t)rows * columnBits[i] / 8;
+    	nodes[2 * i] = rows;
+    	nodes[2 * i + 1] = 0;
+    	buffers[4 * i] = body;
+    	buffers[4 * i + 1] = 0;
+    	buffers[4 * i + 2] = body;
+    	buffers[4 * i + 3] = length;
+    	body += (length + BUFFER_ALIGN - 1) / BUFFER_ALIGN * BUFFER_ALIGN;
+    }
+    uint8_t *metadata = new uint8_t[METADATA_SIZE];
+    Flat f = {metadata, 0, METADATA_SIZE};
+    uint16_t slot[4];
+    uint16_t root = f.pos;
+    f.u32(0);
+    FlatField message[4] = {{0, 2, METADATA_V5}, {1, 1, HEADER_RECORD_BATCH},
+                            {2, 0, 0}, {3, 8, body}};
+    f.link(root, flatTable(f, message, 4, slot));
+    uint16_t header = slot[2];
+    FlatField batch[3] = {{0, 8, rows}, {1, 0, 0}, {2, 0, 0}};
+    f.link(header, flatTable(f, batch, 3, slot));
+    uint16_t nodeSlot = slot[1];
+    uint16_t bufferSlot = slot[2];
+    f.link(nodeSlot, f.structs(nodes, COLUMNS));
+    f.link(bufferSlot, f.structs(buffers, 2 * COLUMNS));
+    if (f.pos <= f.cap) {
+    	writeMessage(metadata, f.pos);
+    	stats.offset = _bytes;
+    	stats.rows = rows;
+    	for (uint8_t i = 0; i < COLUMNS; i++) {
+    		uint32_t length = (uint32_t)rows * columnBits[i] / 8;
+    		write(columns[i], length);
+    		pad((BUFFER_ALIGN - length % BUFFER_ALIGN) % BUFFER_ALIGN);
+    	}
+    	if (_index) {
+    		_index->write((const uint8_t *)&stats, sizeof(stats));
+    	}
+    	_batches++;
+    }
+    delete[] metadata;
+    rows = 0;
+}
+
+//-------------------------------------------------
+void MS_5803_ArrowWriter::end() {
+    flush();
+    // End of stream: continuation marker and a length of 0
+    uint32_t eos[2] = {0xFFFFFFFF, 0};
+    write(eos, 8);
+}
+
+//-------------------------------------------------
+uint32_t MS_5803_ArrowWriter::columnOffset(uint8_t column, uint32_t rows) {
+    uint32_t offset = 0;
+    for (uint8_t i = 0; i < column && i < COLUMNS; i++) {
+    	uint32_t length = rows * columnBits[i] / 8;
+    	offset += (length + BUFFER_ALIGN - 1) / BUFFER_ALIGN * BUFFER_ALIGN;
+    }
+    return offset;
+}
+
+//-------------------------------------------------
+void MS_5803_ArrowWriter::writeMessage(const uint8_t *metadata, 
+                                       uint16_t length) {
+    uint32_t padded = (length + 7) / 8 * 8;
+    uint32_t prefix[2] = {0xFFFFFFFF, padded};
+    write(prefix, 8);
+    write(metadata, length);
+    pad(padded - length);
+}
+
+//-------------------------------------------------
+void MS_5803_ArrowWriter::write(const void *data, uint32_t length) {
+    _out->write((const uint8_t *)data, length);
+    _bytes += length;
+}
+
+//-------------------------------------------------
+void MS_5803_ArrowWriter::pad(uint32_t length) {
+    static const uint8_t zeros[8] = {0};
+    while (length > 0) {
+    	uint8_t n = min(length, (uint32_t)8);
+    	write(zeros, n);
+    	length -= n;
+    }
+}
@@ -0,0 +1,121 @@
+/*
+ *  MS5803_Arrow
+ *  	Writes converted readings in the Apache Arrow IPC stream format, so
+ *  	logs load straight into dataframe tools (pandas, polars, R, DuckDB...)
+ *  	without parsing CSV. The format is written directly; Arrow is not 
+ *  	needed on the device.
+ *
+ *  	Readings are gathered into columns of 'batchRows' rows and each full
+ *  	batch is written as one record batch, with every column buffer 
+ *  	aligned to 64 bytes so readers can use it in place. The columns are
+ *  	  ms          uint32  time of the reading, ms
+ *  	  sensor      uint8   sensor number
+ *  	  pressure    int32   0.01 mbar (MS_5803::pressureInt())
+ *  	  temperature int32   0.01 C (MS_5803::temperatureInt())
+ *  	  d1, d2      uint32  raw ADC values
+ *  	  flags       uint8   free for the application (e.g. quality flags)
+ *
+ *  	The column buffers are written as they are held in memory, which is
+ *  	the little-endian layout Arrow expects on all Arduino targets.
+ *
+ *  	Optionally the statistics of each batch (time, pressure and 
+ *  	temperature ranges, and the sensors in it) are written to a second,
+ *  	index stream, so that queries (MS5803_Query.h) can skip the batches
+ *  	that can't match.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_ARROW__
+#define __MS_5803_ARROW__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "MS5803_Arrow writes column buffers as they are in memory and needs a little-endian CPU"
+#endif
+
+// Columns, in the order they are written
+#define MS5803_ARROW_MS				0
+#define MS5803_ARROW_SENSOR			1
+#define MS5803_ARROW_PRESSURE		2
+#define MS5803_ARROW_TEMPERATURE	3
+#define MS5803_ARROW_D1				4
+#define MS5803_ARROW_D2				5
+#define MS5803_ARROW_FLAGS			6
+
+// Statistics of one record batch, as written to the index stream: 9 
+// little-endian 32-bit fields, 36 bytes
+struct MS_5803_BlockStats {
+    uint32_t offset;         // stream offset of the batch's body
+    uint32_t rows;
+    uint32_t msMin;
+    uint32_t msMax;
+    uint32_t sensors;        // a bit per sensor number; 31 and up share bit 31
+    int32_t pressureMin;
+    int32_t pressureMax;
+    int32_t temperatureMin;
+    int32_t temperatureMax;
+};
+
+class MS_5803_ArrowWriter {
+public:
+    // Needs 22 bytes of RAM per row of a batch
+    MS_5803_ArrowWriter(Print &out, uint16_t batchRows = 256);
+    ~MS_5803_ArrowWriter();
+    MS_5803_ArrowWriter(const MS_5803_ArrowWriter &) = delete;
+    MS_5803_ArrowWriter &operator=(const MS_5803_ArrowWriter &) = delete;
+    // Also write the statistics of each batch to 'index' (NULL for none).
+    // Offsets are counted from begin().
+    void setIndex(Print *index)     {_index = index;}
+    // Write the schema; call once before the first reading
+    void begin();
+    // Add a reading; a full batch is written out
+    void add(uint32_t ms, uint8_t sensor, const MS_5803 &reading, 
+             uint8_t flags = 0) {
+        add(ms, sensor, reading.pressureInt(), reading.temperatureInt(),
+            reading.D1val(), reading.D2val(), flags);
+    }
+    void add(uint32_t ms, uint8_t sensor, int32_t pressure, 
+             int32_t temperature, uint32_t d1, uint32_t d2, 
+             uint8_t flags = 0);
+    // Write the readings gathered so far as a (shorter) batch
+    void flush();
+    // Flush and mark the end of the stream
+    void end();
+    
+    // Record batches and bytes written
+    uint32_t batches() const        {return _batches;}
+    uint32_t bytes() const          {return _bytes;}
+    // Offset of a column in the body of a batch of 'rows' rows
+    static uint32_t columnOffset(uint8_t column, uint32_t rows);
+
+private:
+    Print *_out;
+    Print *_index;
+    MS_5803_BlockStats stats;
+    uint16_t capacity;
+    uint16_t rows;
+    uint32_t _batches;
+    uint32_t _bytes;
+    uint32_t *ms;
+    uint8_t *sensors;
+    int32_t *pressures;
+    int32_t *temperatures;
+    uint32_t *d1s;
+    uint32_t *d2s;
+    uint8_t *flagValues;
+    
+    // Write a message: continuation, metadata length, metadata padded to
+    // 8 bytes
+    void writeMessage(const uint8_t *metadata, uint16_t length);
+    void write(const void *data, uint32_t length);
+    void pad(uint32_t length);
+};
+
+#endif
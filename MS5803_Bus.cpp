@@ -0,0 +1,134 @@
+/*
+ *  MS5803_Bus
+ *  	Priority-aware arbiter for a shared I2C bus. See MS5803_Bus.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Bus.h"
+
+// Short critical sections around the arbiter state. On the ESP32 a spinlock
+// also covers the other core; elsewhere interrupts are disabled, and then
+// restored to how they were, so the arbiter can be used from code that
+// runs with interrupts off. Each function locks at most once per scope.
+#if defined(ESP32)
+static portMUX_TYPE arbiterMux = portMUX_INITIALIZER_UNLOCKED;
+#define ARBITER_LOCK()		portENTER_CRITICAL(&arbiterMux)
+#define ARBITER_UNLOCK()	portEXIT_CRITICAL(&arbiterMux)
+#elif defined(__AVR__)
+#define ARBITER_LOCK()		uint8_t arbiterSreg = SREG; noInterrupts()
+#define ARBITER_UNLOCK()	SREG = arbiterSreg
+#elif defined(ESP8266)
+#define ARBITER_LOCK()		uint32_t arbiterPs = xt_rsil(15)
+#define ARBITER_UNLOCK()	xt_wsr_ps(arbiterPs)
+#elif defined(__arm__)
+#define ARBITER_LOCK()		uint32_t arbiterPrimask = __get_PRIMASK(); __disable_irq()
+#define ARBITER_UNLOCK()	__set_PRIMASK(arbiterPrimask)
+#else
+// No portable way to read the interrupt state: assumes they were enabled
+#define ARBITER_LOCK()		noInterrupts()
+#define ARBITER_UNLOCK()	interrupts()
+#endif
+
+// Waiting for the bus. On the ESP32 the task blocks for a tick, so that a
+// lower priority task holding the bus gets to run and release it; yield()
+// would only let in tasks of the same priority or higher.
+#if defined(ESP32)
+#define ARBITER_WAIT()		vTaskDelay(1)
+#else
+#define ARBITER_WAIT()		yield()
+#endif
+
+//-------------------------------------------------
+// Constructor
+MS_5803_BusArbiter::MS_5803_BusArbiter() {
+    busy = false;
+    for (uint8_t i = 0; i < MS5803_PRIORITIES; i++) {
+    	waiting[i] = 0;
+    }
+    resetStats();
+}
+
+//-------------------------------------------------
+boolean MS_5803_BusArbiter::tryTake(uint8_t priority, boolean queued) {
+    boolean taken = false;
+    ARBITER_LOCK();
+    if (!busy) {
+    	taken = true;
+    	for (uint8_t i = 0; i < priority; i++) {
+    		if (waiting[i]) {
+    			taken = false;
+    			break;
+    		}
+    	}
+    }
+    if (taken) {
+    	busy = true;
+    	if (queued) {
+    		waiting[priority]--;
+    	}
+    } else if (!queued) {
+    	waiting[priority]++;
+    }
+    ARBITER_UNLOCK();
+    return taken;
+}
+
+//-------------------------------------------------
+boolean MS_5803_BusArbiter::acquire(uint8_t priority, uint32_t timeoutUs) {
+    if (priority >= MS5803_PRIORITIES) {
+    	priority = MS5803_PRIORITIES - 1;
+    }
+    unsigned long start = micros();
+    boolean queued = false;
+    while (!tryTake(priority, queued)) {
+    	queued = true;
+    	if (micros() - start >= timeoutUs) {
+    		ARBITER_LOCK();
+    		waiting[priority]--;
+    		ARBITER_UNLOCK();
+    		_timeouts[priority]++;
+    		return false;
+    	}
+    	ARBITER_WAIT();
+    }
+    uint32_t waited = micros() - start;
+    if (waited > maxWait[priority]) {
+    	maxWait[priority] = waited;
+    }
+    _grants[priority]++;
+    return true;
+}
+
+//-------------------------------------------------
+void MS_5803_BusArbiter::release() {
+    ARBITER_LOCK();
+    busy = false;
+    ARBITER_UNLOCK();
+}
+
+//-------------------------------------------------
+uint32_t MS_5803_BusArbiter::maxWaitMicros(uint8_t priority) const {
+    return priority < MS5803_PRIORITIES ? maxWait[priority] : 0;
+}
+
+uint32_t MS_5803_BusArbiter::grants(uint8_t priority) const {
+    return priority < MS5803_PRIORITIES ? _grants[priority] : 0;
+}
+
+uint32_t MS_5803_BusArbiter::timeouts(uint8_t priority) const {
+    return priority < MS5803_PRIORITIES ? _timeouts[priority] : 0;
+}
+
+//-------------------------------------------------
+void MS_5803_BusArbiter::resetStats() {
+    for (uint8_t i = 0; i < MS5803_PRIORITIES; i++) {
+    	maxWait[i] = 0;
+    	_grants[i] = 0;
+    	_timeouts[i] = 0;
+    }
+}
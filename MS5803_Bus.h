@@ -0,0 +1,63 @@
+/*
+ *  MS5803_Bus
+ *  	Priority-aware arbiter for an I2C bus shared between an MS5803 and
+ *  	other clients (RTC, EEPROM, display...). Clients acquire the bus for
+ *  	each transaction, or short group of transactions, and release it 
+ *  	afterwards. When the bus is released it goes to the highest priority
+ *  	class with a client waiting, so a time-critical sensor read gets in 
+ *  	between the transactions of a long bulk transfer rather than after 
+ *  	it. Waits are bounded by a timeout.
+ *
+ *  	The arbiter is safe to use from several FreeRTOS tasks on the ESP32,
+ *  	where a waiting task blocks a tick at a time so that the task holding
+ *  	the bus can run, whatever its priority. A transaction is never
+ *  	interrupted, so the worst-case wait of the most urgent class is the
+ *  	longest single hold by any client (rounded up to the tick on the 
+ *  	ESP32); keep bulk clients' holds short. The arbiter keeps the longest
+ *  	wait seen by each priority class, to check the worst-case latency of
+ *  	a configuration (see the MS5803_05_bus example).
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_BUS__
+#define __MS_5803_BUS__
+
+#include <Arduino.h>
+
+#define MS5803_PRIORITIES		4	// Number of priority classes
+#define MS5803_PRIORITY_CRITICAL	0	// e.g. pressure reads
+#define MS5803_PRIORITY_HIGH		1
+#define MS5803_PRIORITY_NORMAL		2	// e.g. RTC, EEPROM
+#define MS5803_PRIORITY_BULK		3	// e.g. display updates
+
+class MS_5803_BusArbiter {
+public:
+    MS_5803_BusArbiter();
+    // Wait up to timeoutUs for the bus. Returns true once it is granted,
+    // false on timeout. Priority 0 is the most urgent.
+    boolean acquire(uint8_t priority, uint32_t timeoutUs);
+    // Give the bus back after a successful acquire()
+    void release();
+    // Worst-case and total wait (us), grants and timeouts per priority
+    uint32_t maxWaitMicros(uint8_t priority) const;
+    uint32_t grants(uint8_t priority) const;
+    uint32_t timeouts(uint8_t priority) const;
+    void resetStats();
+
+private:
+    volatile boolean busy;
+    // Clients waiting in each priority class
+    volatile uint8_t waiting[MS5803_PRIORITIES];
+    uint32_t maxWait[MS5803_PRIORITIES];
+    uint32_t _grants[MS5803_PRIORITIES];
+    uint32_t _timeouts[MS5803_PRIORITIES];
+    // Take the bus if it is free and nobody more urgent is waiting
+    boolean tryTake(uint8_t priority, boolean queued);
+};
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ *  MS5803_Calibration
+ *  	Offset and gain harmonisation for arrays of MS5803 sensors. See 
+ *  	MS5803_Calibration.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Calibration.h"
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Calibration::MS_5803_Calibration(float minSpread) {
+    _minSpread = minSpread;
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_Calibration::reset() {
+    n = 0;
+    meanX = 0;
+    meanY = 0;
+    sxx = 0;
+    sxy = 0;
+}
+
+//-------------------------------------------------
+void MS_5803_Calibration::add(int32_t sensor, int32_t reference) {
+    // Welford style update of the means and centred sums, which stays 
+    // accurate for pressures near 100000 (1000 mbar) over long runs.
+    n++;
+    double dx = sensor - meanX;
+    meanX += dx / n;
+    meanY += (reference - meanY) / n;
+    sxx += dx * (sensor - meanX);
+    sxy += dx * (reference - meanY);
+}
+
+//-------------------------------------------------
+float MS_5803_Calibration::gain() const {
+    // Only fit a gain if the sensor pressure varied enough
+    if (n < 2 || sxx < (double)_minSpread * _minSpread * n) {
+    	return 1;
+    }
+    return sxy / sxx;
+}
+
+//-------------------------------------------------
+float MS_5803_Calibration::offset() const {
+    return meanY - gain() * meanX;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Calibration::apply(MS_5803 &sensor) const {
+    if (n == 0) {
+    	return false;
+    }
+    // The sensor already reports y0 = x + o + g * x with its raw pressure x.
+    // The fit gives y = a + b * y0, so y = (a + b * o) + b * (1 + g) * x.
+    double g = sensor.calibrationGain() / 1048576.0;
+    double b = gain();
+    double o = offset() + b * sensor.calibrationOffset();
+    double newGain = (b * (1 + g) - 1) * 1048576.0;
+    sensor.setCalibration((int32_t)lround(o), (int16_t)constrain(lround(newGain),
+    		-MS5803_CAL_GAIN_MAX, MS5803_CAL_GAIN_MAX));
+    return true;
+}
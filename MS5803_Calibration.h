@@ -0,0 +1,57 @@
+/*
+ *  MS5803_Calibration
+ *  	Estimates the offset and gain correction that brings one MS5803 into
+ *  	agreement with a reference, for sensors in an array that should read
+ *  	the same pressure: co-located sensors, or any sensors during a quiet
+ *  	period. The reference can be a trusted sensor or the array mean.
+ *
+ *  	Pairs of (sensor, reference) pressures are added one at a time and an
+ *  	incremental least squares fit of reference = offset + gain * sensor is
+ *  	kept. When the pressures don't vary enough to fit a gain (e.g. a 
+ *  	single quiet period), only the offset is estimated. apply() stores the
+ *  	result in the MS_5803 object, where it is applied in integer math to 
+ *  	every reading.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_CALIBRATION__
+#define __MS_5803_CALIBRATION__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+class MS_5803_Calibration {
+public:
+    // The argument is the smallest standard deviation of the sensor pressure
+    // (0.01 mbar) for which a gain is fitted. Below it only the offset is.
+    MS_5803_Calibration(float minSpread = 100);
+    // Forget all pairs added so far
+    void reset();
+    // Add one pair of pressures in 0.01 mbar, as from pressureInt(). The 
+    // sensor value should be taken with the current calibration applied.
+    void add(int32_t sensor, int32_t reference);
+    // Number of pairs added since the last reset()
+    uint32_t count() const          {return n;}
+    // Fitted correction: reference = offset() + gain() * sensor
+    float offset() const;
+    float gain() const;
+    // Combine the fitted correction with the one the sensor already applies
+    // and store it in the sensor. Returns false if there are no pairs.
+    boolean apply(MS_5803 &sensor) const;
+
+private:
+    float _minSpread;
+    uint32_t n;
+    // Running means and centred sums of squares and products
+    double meanX;
+    double meanY;
+    double sxx;
+    double sxy;
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ *  MS5803_CommandList
+ *  	Batched bus operations for several MS5803 sensors. See 
+ *  	MS5803_CommandList.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_CommandList.h"
+#include "MS5803_Sim.h"
+
+// The command link API of the ESP-IDF 4 I2C driver, which Wire is built 
+// on in Arduino-ESP32 2.x. ESP-IDF 5 replaced it with a per-device driver.
+#if defined(ESP32)
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION_MAJOR < 5
+#include <driver/i2c.h>
+#define MS5803_CMD_LINK 1
+#endif
+#endif
+#ifndef MS5803_CMD_LINK
+#define MS5803_CMD_LINK 0
+#endif
+
+// Longest a batch may take on the bus, ms
+#define LINK_TIMEOUT_MS 50
+
+//-------------------------------------------------
+// Constructor
+MS_5803_CommandList::MS_5803_CommandList(uint8_t capacity, 
+                                         uint8_t transport) {
+    ops = new Op[capacity];
+    results = new uint8_t[3 * capacity];
+    _capacity = ops && results ? capacity : 0;
+    length = 0;
+    _transport = transport;
+    _submissions = 0;
+    _operations = 0;
+    _driverCalls = 0;
+    _errors = 0;
+}
+
+//-------------------------------------------------
+// Destructor
+MS_5803_CommandList::~MS_5803_CommandList() {
+    delete[] ops;
+    delete[] results;
+}
+
+//-------------------------------------------------
+boolean MS_5803_CommandList::add(MS_5803 &sensor, uint8_t op) {
+    if (length >= _capacity || op > MS5803_OP_READ_D2) {
+    	return false;
+    }
+    ops[length].sensor = &sensor;
+    ops[length].op = op;
+    length++;
+    return true;
+}
+
+//-------------------------------------------------
+boolean MS_5803_CommandList::batchable() const {
+    if (length == 0) {
+    	return false;
+    }
+    boolean simulated = ops[0].sensor->simulator != NULL;
+    for (uint8_t i = 0; i < length; i++) {
+    	const MS_5803 *sensor = ops[i].sensor;
+    	if ((sensor->simulator != NULL) != simulated || sensor->arbiter != NULL
+    			|| sensor->_wire != ops[0].sensor->_wire) {
+    		return false;
+    	}
+    }
+    return simulated || MS5803_CMD_LINK;
+}
+
+//-------------------------------------------------
+uint8_t MS_5803_CommandList::submit() {
+    uint8_t readings;
+    if (_transport == MS5803_TRANSPORT_BATCHED && batchable()) {
+    	readings = submitBatched();
+    } else {
+    	readings = submitSequential();
+    }
+    _submissions++;
+    _operations += length;
+    return readings;
+}
+
+//-------------------------------------------------
+uint8_t MS_5803_CommandList::submitSequential() {
+    uint8_t readings = 0;
+    for (uint8_t i = 0; i < length; i++) {
+    	MS_5803 *sensor = ops[i].sensor;
+    	switch (ops[i].op) {
+    		case MS5803_OP_START_D1:
+    			sensor->startPressure();
+    			_driverCalls++;
+    			break;
+    		case MS5803_OP_READ_D1:
+    			sensor->readPressure();
+    			_driverCalls += 2;
+    			break;
+    		case MS5803_OP_START_D2:
+    			sensor->startTemperature();
+    			_driverCalls++;
+    			break;
+    		case MS5803_OP_READ_D2:
+    			if (sensor->readTemperature()) {
+    				readings++;
+    			}
+    			_driverCalls += 2;
+    			break;
+    	}
+    }
+    return readings;
+}
+
+//-------------------------------------------------
+// Runs the list in one driver call (or, for simulated sensors, as if it 
+// were), then hands each sensor its results.
+uint8_t MS_5803_CommandList::submitBatched() {
+    _driverCalls++;
+    boolean simulated = ops[0].sensor->simulator != NULL;
+    if (!simulated && !runLink()) {
+    	_errors++;
+    	return 0;
+    }
+    uint8_t readings = 0;
+    for (uint8_t i = 0; i < length; i++) {
+    	MS_5803 *sensor = ops[i].sensor;
+    	uint8_t op = ops[i].op;
+    	char command = (op < MS5803_OP_START_D2 ? CMD_ADC_D1 : CMD_ADC_D2) 
+    	               + sensor->osrCommand();
+    	MS_5803_Counters &counters = sensor->counters;
+    	if (op == MS5803_OP_START_D1 || op == MS5803_OP_START_D2) {
+    		if (simulated) {
+    			sensor->simResult = sensor->simulator->convert(command);
+    		}
+    		counters.transactions++;
+    		counters.bytes++;
+    		counters.conversions[MS_5803::osrIndex(command)]++;
+    		continue;
+    	}
+    	uint32_t value = sensor->simResult;
+    	if (!simulated) {
+    		const uint8_t *r = results + 3 * i;
+    		value = ((uint32_t)r[0] << 16) | ((uint32_t)r[1] << 8) | r[2];
+    	}
+    	counters.transactions += 2;
+    	counters.bytes += 4;
+    	if (op == MS5803_OP_READ_D1) {
+    		sensor->varD1 = value;
+    	} else {
+    		sensor->varD2 = value;
+    		sensor->convertRaw(sensor->varD1, sensor->varD2);
+    		readings++;
+    	}
+    }
+    return readings;
+}
+
+//-------------------------------------------------
+boolean MS_5803_CommandList::runLink() {
+#if MS5803_CMD_LINK
+    // Wire and Wire1 are the driver's ports 0 and 1
+    i2c_port_t port = ops[0].sensor->_wire == &Wire ? I2C_NUM_0 : I2C_NUM_1;
+    i2c_cmd_handle_t link = i2c_cmd_link_create();
+    if (link == NULL) {
+    	return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+    	MS_5803 *sensor = ops[i].sensor;
+    	uint8_t op = ops[i].op;
+    	uint8_t address = sensor->_address << 1;
+    	i2c_master_start(link);
+    	i2c_master_write_byte(link, address | I2C_MASTER_WRITE, true);
+    	if (op == MS5803_OP_START_D1 || op == MS5803_OP_START_D2) {
+    		char command = (op == MS5803_OP_START_D1 ? CMD_ADC_D1 : CMD_ADC_D2)
+    		               + sensor->osrCommand();
+    		i2c_master_write_byte(link, CMD_ADC_CONV + command, true);
+    	} else {
+    		// The read command, then the 3 result bytes, as readADC() does
+    		i2c_master_write_byte(link, CMD_ADC_READ, true);
+    		i2c_master_stop(link);
+    		i2c_master_start(link);
+    		i2c_master_write_byte(link, address | I2C_MASTER_READ, true);
+    		i2c_master_read(link, results + 3 * i, 3, I2C_MASTER_LAST_NACK);
+    	}
+    	i2c_master_stop(link);
+    }
+    esp_err_t err = i2c_master_cmd_begin(port, link, 
+                                         pdMS_TO_TICKS(LINK_TIMEOUT_MS));
+    i2c_cmd_link_delete(link);
+    return err == ESP_OK;
+#else
+    return false;
+#endif
+}
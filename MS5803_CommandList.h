@@ -0,0 +1,98 @@
+/*
+ *  MS5803_CommandList
+ *  	Batches the bus operations for several MS5803 sensors into one list
+ *  	that is submitted at once, e.g. once per tick of a multi-sensor 
+ *  	schedule: "read sensor A's pressure, start A's temperature, read B's
+ *  	temperature, start B's pressure, ...". Operations never wait for a 
+ *  	conversion; the schedule has to leave conversionDelay() ms between
+ *  	starting a conversion and reading it.
+ *
+ *  	With the sequential transport every I2C transaction is a separate 
+ *  	call into the Wire library, as when the sensors are read one by one
+ *  	(one for starting a conversion, two for reading one). With the 
+ *  	batched transport the whole list is handed to the I2C driver as one
+ *  	command link (ESP-IDF's i2c_cmd_link) and run in a single call, which
+ *  	saves the per-transaction software overhead and task switches. The
+ *  	transactions on the bus are the same either way.
+ *
+ *  	The batched transport needs the ESP-IDF 4 I2C driver that Wire uses
+ *  	on ESP32 boards (Arduino-ESP32 2.x), all the sensors on one bus, and
+ *  	no bus arbiter. Lists of simulated sensors (see MS5803_Sim.h) are 
+ *  	batched too, so the savings can be measured without hardware. 
+ *  	Otherwise submit() falls back to the sequential transport.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_COMMANDLIST__
+#define __MS_5803_COMMANDLIST__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+// Operations on one sensor
+#define MS5803_OP_START_D1	0	// Start the pressure conversion
+#define MS5803_OP_READ_D1	1	// Read the pressure conversion
+#define MS5803_OP_START_D2	2	// Start the temperature conversion
+#define MS5803_OP_READ_D2	3	// Read the temperature, completing a reading
+
+// How submit() hands the operations to the I2C driver
+#define MS5803_TRANSPORT_SEQUENTIAL	0	// One driver call per transaction
+#define MS5803_TRANSPORT_BATCHED	1	// One driver call per submit()
+
+class MS_5803_CommandList {
+public:
+    // Largest number of operations in the list
+    MS_5803_CommandList(uint8_t capacity, 
+                        uint8_t transport = MS5803_TRANSPORT_SEQUENTIAL);
+    ~MS_5803_CommandList();
+    MS_5803_CommandList(const MS_5803_CommandList &) = delete;
+    MS_5803_CommandList &operator=(const MS_5803_CommandList &) = delete;
+    // Append an operation. Returns false if the list is full.
+    boolean add(MS_5803 &sensor, uint8_t op);
+    // Empty the list
+    void clear()                    {length = 0;}
+    uint8_t size() const            {return length;}
+    void setTransport(uint8_t transport) {_transport = transport;}
+    // True if submit() can batch the current list
+    boolean batchable() const;
+    // Run all the operations in order. Returns the number of readings 
+    // completed (MS5803_OP_READ_D2 operations). The list is kept, so the
+    // same list can be submitted again next tick. If a batch fails on the
+    // bus, no reading is updated and 0 is returned.
+    uint8_t submit();
+    // Number of submissions and of operations run since construction
+    uint32_t submissions() const    {return _submissions;}
+    uint32_t operations() const     {return _operations;}
+    // Calls into the I2C driver since construction, and batches it failed
+    uint32_t driverCalls() const    {return _driverCalls;}
+    uint32_t errors() const         {return _errors;}
+
+private:
+    struct Op {
+    	MS_5803 *sensor;
+    	uint8_t op;
+    };
+    Op *ops;
+    // Results of the reads of a batch, 3 bytes each
+    uint8_t *results;
+    uint8_t _capacity;
+    uint8_t length;
+    uint8_t _transport;
+    uint32_t _submissions;
+    uint32_t _operations;
+    uint32_t _driverCalls;
+    uint32_t _errors;
+    
+    uint8_t submitSequential();
+    uint8_t submitBatched();
+    // Run the list as one command link on the bus. Returns false if the
+    // driver reported an error.
+    boolean runLink();
+};
+
+#endif
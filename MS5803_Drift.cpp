@@ -0,0 +1,74 @@
+/*
+ *  MS5803_Drift
+ *  	Streaming CUSUM drift detector for the MS5803. See MS5803_Drift.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Drift.h"
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Drift::MS_5803_Drift(int32_t allowance, int32_t threshold,
+                             uint16_t warmup, uint8_t baselineShift) {
+    _allowance = allowance;
+    _threshold = threshold;
+    _warmup = warmup > 0 ? warmup : 1;
+    _baselineShift = baselineShift;
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_Drift::reset() {
+    _flags = MS5803_DRIFT_NONE;
+    n = 0;
+    warmupSum = 0;
+    _level = 0;
+    sumUp = 0;
+    sumDown = 0;
+    baseline = 0;
+}
+
+//-------------------------------------------------
+uint8_t MS_5803_Drift::update(int32_t sensor, int32_t reference) {
+    int32_t diff = sensor - reference;
+    n++;
+    // Learn the normal difference first
+    if (n <= _warmup) {
+    	warmupSum += diff;
+    	if (n == _warmup) {
+    		_level = (int32_t)(warmupSum / _warmup);
+    	}
+    	return _flags;
+    }
+    // Two-sided CUSUM, with the sums held at the threshold once it is 
+    // passed so they cannot overflow on a long deployment.
+    int32_t dev = diff - _level;
+    sumUp = max((int32_t)0, sumUp + dev - _allowance);
+    sumDown = max((int32_t)0, sumDown - dev - _allowance);
+    if (sumUp >= _threshold) {
+    	sumUp = _threshold;
+    	_flags |= MS5803_DRIFT_UP;
+    }
+    if (sumDown >= _threshold) {
+    	sumDown = _threshold;
+    	_flags |= MS5803_DRIFT_DOWN;
+    }
+    return _flags;
+}
+
+//-------------------------------------------------
+uint8_t MS_5803_Drift::update(int32_t sensor) {
+    // Exponential moving average with a time constant of 2^shift readings,
+    // started at the first reading. Kept scaled by 2^8 for resolution.
+    if (n == 0) {
+    	baseline = sensor * 256;
+    } else {
+    	baseline += (sensor * 256 - baseline) >> _baselineShift;
+    }
+    return update(sensor, baseline / 256);
+}
@@ -0,0 +1,76 @@
+/*
+ *  MS5803_Drift
+ *  	Streaming detector for offset drift of an MS5803 over long deployments.
+ *  	Each reading is compared with a neighbour sensor that should see the
+ *  	same pressure, and the difference is run through a two-sided CUSUM. 
+ *  	The level of the difference is learned over a warm-up period, after 
+ *  	which a sustained shift of more than 'allowance' raises a flag once
+ *  	the cumulative sum passes 'threshold'.
+ *
+ *  	Without a neighbour, a sensor can be compared with a slow baseline of
+ *  	its own readings instead. That baseline follows slow changes, real or
+ *  	not, so this only catches offset steps (e.g. after a knock or a 
+ *  	change to the housing) that are faster than its time constant. Slow
+ *  	drift can't be told apart from the weather by one sensor alone and 
+ *  	needs a reference.
+ *
+ *  	Memory use is constant and the math is integer, in units of 0.01 mbar
+ *  	as returned by MS_5803::pressureInt().
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_DRIFT__
+#define __MS_5803_DRIFT__
+
+#include <Arduino.h>
+
+#define MS5803_DRIFT_NONE	0x00	// No drift detected
+#define MS5803_DRIFT_UP		0x01	// Sensor drifted up relative to reference
+#define MS5803_DRIFT_DOWN	0x02	// Sensor drifted down relative to reference
+
+class MS_5803_Drift {
+public:
+    // Allowance and threshold are in 0.01 mbar. The warm-up is the number of
+    // readings used to learn the normal sensor - reference difference. The
+    // baseline shift sets the time constant (2^shift readings) of the slow
+    // baseline used when no reference is given; steps that settle within
+    // it are detected.
+    MS_5803_Drift(int32_t allowance = 5, int32_t threshold = 2000,
+                  uint16_t warmup = 100, uint8_t baselineShift = 12);
+    // Clear the flags, the sums and the learned level
+    void reset();
+    // Add one reading compared with a neighbour's reading. Returns the flags.
+    uint8_t update(int32_t sensor, int32_t reference);
+    // Add one reading compared with the sensor's slow baseline. Detects 
+    // offset steps only, not slow drift.
+    uint8_t update(int32_t sensor);
+    // Flags raised so far (MS5803_DRIFT_UP / MS5803_DRIFT_DOWN)
+    uint8_t flags() const           {return _flags;}
+    // Learned level of the difference and the current CUSUM statistics
+    int32_t level() const           {return _level;}
+    int32_t upperSum() const        {return sumUp;}
+    int32_t lowerSum() const        {return sumDown;}
+    // Number of readings since reset()
+    uint32_t count() const          {return n;}
+
+private:
+    int32_t _allowance;
+    int32_t _threshold;
+    uint16_t _warmup;
+    uint8_t _baselineShift;
+    uint8_t _flags;
+    uint32_t n;
+    int64_t warmupSum;
+    int32_t _level;
+    int32_t sumUp;
+    int32_t sumDown;
+    // Slow baseline, scaled by 2^8
+    int32_t baseline;
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ *  MS5803_Energy
+ *  	Energy accounting for the MS5803_05 library. See MS5803_Energy.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Energy.h"
+
+// Supply current of the MS5803 at 1 sample per second, indexed by OSR
+// (256, 512, 1024, 2048, 4096), in uA. See page 2 of the MS5803-05BA data 
+// sheet. At one conversion per second this is the charge of one conversion
+// in uC.
+static const float convCharge[5] = {1.0, 1.7, 3.2, 6.3, 12.5};
+// Standby supply current of the MS5803 in uA.
+#define MS5803_STANDBY_UA 0.14
+// Bits clocked per transaction besides the data bytes: start, address byte
+// with its ACK, and stop.
+#define BUS_OVERHEAD_BITS 11
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Energy::MS_5803_Energy(float supplyVolts, float mcuActiveMilliAmps,
+                               float mcuSleepMicroAmps, uint32_t busHz,
+                               float pullupOhms) {
+    _volts = supplyVolts;
+    _mcuActiveMilliAmps = mcuActiveMilliAmps;
+    _mcuSleepMicroAmps = mcuSleepMicroAmps;
+    _busHz = busHz;
+    _pullupOhms = pullupOhms;
+}
+
+//-------------------------------------------------
+float MS_5803_Energy::conversionMicroJoules(uint16_t Resolution) const {
+    for (uint8_t i = 0; i < 5; i++) {
+    	if (Resolution == (256U << i)) {
+    		return convCharge[i] * _volts;
+    	}
+    }
+    return 0;
+}
+
+//-------------------------------------------------
+float MS_5803_Energy::busMicros(uint32_t transactions, uint32_t bytes) const {
+    // Each data byte is 8 bits plus the ACK bit
+    float bits = (float)transactions * BUS_OVERHEAD_BITS + (float)bytes * 9;
+    return bits * 1000000.0 / _busHz;
+}
+
+//-------------------------------------------------
+float MS_5803_Energy::wakeMicroJoules(float awakeMicros, float busMicros) const {
+    // The MCU draws its active current the whole time it is awake. While the
+    // bus is busy each line is held low about half of the time, drawing
+    // V/R through its pull-up resistor.
+    float mcu = _mcuActiveMilliAmps * _volts * awakeMicros / 1000.0;
+    float pullups = _volts * _volts / _pullupOhms * busMicros;
+    return mcu + pullups;
+}
+
+//-------------------------------------------------
+float MS_5803_Energy::readingMicroJoules(uint16_t Resolution) const {
+    // readSensor() does two conversions, each with a 1-byte conversion 
+    // command, a 1-byte read command and a 3-byte read.
+    float bus = busMicros(6, 10);
+    float awake = 2000.0 * MS_5803::conversionDelay(Resolution) + bus;
+    return 2 * conversionMicroJoules(Resolution) + wakeMicroJoules(awake, bus);
+}
+
+//-------------------------------------------------
+float MS_5803_Energy::microJoules(const MS_5803_Counters &activity) const {
+    float sensor = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+    	sensor += activity.conversions[i] * convCharge[i] * _volts;
+    }
+    float bus = busMicros(activity.transactions, activity.bytes);
+    float awake = 1000.0 * activity.waitMs + bus;
+    return sensor + wakeMicroJoules(awake, bus);
+}
+
+//-------------------------------------------------
+float MS_5803_Energy::averageMicroAmps(uint16_t Resolution,
+                                       float readingsPerHour) const {
+    // Charge per reading in uC, spread over an hour
+    float charge = readingMicroJoules(Resolution) / _volts;
+    return charge * readingsPerHour / 3600.0 + _mcuSleepMicroAmps
+    		+ MS5803_STANDBY_UA;
+}
+
+//-------------------------------------------------
+float MS_5803_Energy::batteryLifeHours(float batteryMilliAmpHours,
+                                       uint16_t Resolution,
+                                       float readingsPerHour) const {
+    float uA = averageMicroAmps(Resolution, readingsPerHour);
+    if (uA <= 0) {
+    	return 0;
+    }
+    return batteryMilliAmpHours * 1000.0 / uA;
+}
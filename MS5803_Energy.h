@@ -0,0 +1,60 @@
+/*
+ *  MS5803_Energy
+ *  	Energy accounting for the MS5803_05 library. Combines the data sheet
+ *  	supply current of the MS5803 at each oversampling resolution with the
+ *  	conversion waits, I2C bus time and MCU wake time of the driver to give
+ *  	the energy spent per reading and a projected battery life for a
+ *  	sampling schedule.
+ *
+ *  	The same model can be applied to the activity counters kept by an 
+ *  	MS_5803 object (see MS_5803::activity()), so that the per-reading 
+ *  	estimate can be checked against what the driver actually did.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_ENERGY__
+#define __MS_5803_ENERGY__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+class MS_5803_Energy {
+public:
+    // Supply voltage of the sensor and MCU, MCU current while awake (mA) and
+    // asleep (uA), I2C clock (Hz) and I2C pull-up resistance (ohm).
+    MS_5803_Energy(float supplyVolts = 3.3, float mcuActiveMilliAmps = 20.0,
+                   float mcuSleepMicroAmps = 10.0, uint32_t busHz = 100000,
+                   float pullupOhms = 10000.0);
+
+    // Energy (uJ) drawn by the sensor for one ADC conversion.
+    float conversionMicroJoules(uint16_t Resolution) const;
+    // Time (us) the bus is busy for one transaction moving 'bytes' bytes.
+    float busMicros(uint32_t transactions, uint32_t bytes) const;
+    // Energy (uJ) of one readSensor() call: D1 and D2 conversions, the bus
+    // traffic to start and read them, and the MCU awake for all of it.
+    float readingMicroJoules(uint16_t Resolution) const;
+    // Energy (uJ) of the activity recorded in an MS_5803's counters.
+    float microJoules(const MS_5803_Counters &activity) const;
+    // Average current (uA) when taking 'readingsPerHour' readings per hour
+    // and sleeping in between.
+    float averageMicroAmps(uint16_t Resolution, float readingsPerHour) const;
+    // Projected battery life (hours) for a battery of the given capacity.
+    float batteryLifeHours(float batteryMilliAmpHours, uint16_t Resolution,
+                           float readingsPerHour) const;
+
+private:
+    float _volts;
+    float _mcuActiveMilliAmps;
+    float _mcuSleepMicroAmps;
+    uint32_t _busHz;
+    float _pullupOhms;
+    // Energy (uJ) for the MCU and pull-ups over the given awake and bus time.
+    float wakeMicroJoules(float awakeMicros, float busMicros) const;
+};
+
+#endif
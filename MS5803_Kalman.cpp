@@ -0,0 +1,215 @@
+/*
+ *  MS5803_Kalman
+ *  	Kalman filters for altitude or depth and vertical speed. See 
+ *  	MS5803_Kalman.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Kalman.h"
+
+// Pressure of 1 m of sea water in mbar
+#define MBAR_PER_M 100.5
+// Variance of rounding to 0.01 mbar, in mbar^2
+#define ROUNDING_VARIANCE (0.0001 / 12)
+// Variance of the first position and velocity estimates
+#define START_VARIANCE 1e4
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Kalman::MS_5803_Kalman(uint8_t mode, float processNoise, 
+                               boolean acceleration) {
+    _mode = mode;
+    states = acceleration ? 3 : 2;
+    q = processNoise * processNoise;
+    reference = 1013.25;
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_Kalman::reset() {
+    started = false;
+    lastMs = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+    	x[i] = 0;
+    	for (uint8_t j = 0; j < 3; j++) {
+    		p[i][j] = 0;
+    	}
+    }
+}
+
+//-------------------------------------------------
+void MS_5803_Kalman::update(const MS_5803 &sensor, uint32_t ms) {
+    float mbar = sensor.pressure();
+    float k = slope(mbar);
+    float noise = MS_5803::pressureNoise(sensor.resolution());
+    update(ms, toPosition(mbar), k * k * (noise * noise + ROUNDING_VARIANCE));
+}
+
+//-------------------------------------------------
+void MS_5803_Kalman::update(uint32_t ms, float position, float variance) {
+    if (!started) {
+    	started = true;
+    	lastMs = ms;
+    	x[0] = position;
+    	p[0][0] = variance;
+    	for (uint8_t i = 1; i < states; i++) {
+    		p[i][i] = START_VARIANCE;
+    	}
+    	return;
+    }
+    predict((ms - lastMs) / 1000.0);
+    lastMs = ms;
+    // The position is measured directly (H = [1 0 0]), so the gain is the
+    // first column of P over the innovation variance.
+    float s = p[0][0] + variance;
+    float gain[3];
+    for (uint8_t i = 0; i < states; i++) {
+    	gain[i] = p[i][0] / s;
+    }
+    float innovation = position - x[0];
+    for (uint8_t i = 0; i < states; i++) {
+    	x[i] += gain[i] * innovation;
+    }
+    float row[3] = {p[0][0], p[0][1], p[0][2]};
+    for (uint8_t i = 0; i < states; i++) {
+    	for (uint8_t j = 0; j <= i; j++) {
+    		p[i][j] -= gain[i] * row[j];
+    		p[j][i] = p[i][j];
+    	}
+    }
+}
+
+//-------------------------------------------------
+// P = F P F^T + Q for a step of dt seconds, with F the constant velocity 
+// (or acceleration) model and Q from a random acceleration (or jerk) of 
+// variance q held over the step.
+void MS_5803_Kalman::predict(float dt) {
+    float dt2 = dt * dt / 2;
+    float f[3][3] = {{1, dt, dt2}, {0, 1, dt}, {0, 0, 1}};
+    float g[3];
+    if (states == 3) {
+    	g[0] = dt2 * dt / 3;
+    	g[1] = dt2;
+    	g[2] = dt;
+    }
+    else {
+    	g[0] = dt2;
+    	g[1] = dt;
+    	g[2] = 0;
+    }
+    float next[3] = {0, 0, 0};
+    float fp[3][3];
+    for (uint8_t i = 0; i < states; i++) {
+    	for (uint8_t j = 0; j < states; j++) {
+    		next[i] += f[i][j] * x[j];
+    		fp[i][j] = 0;
+    		for (uint8_t k = i; k < states; k++) {
+    			fp[i][j] += f[i][k] * p[k][j];
+    		}
+    	}
+    }
+    for (uint8_t i = 0; i < states; i++) {
+    	x[i] = next[i];
+    	for (uint8_t j = 0; j <= i; j++) {
+    		float sum = q * g[i] * g[j];
+    		for (uint8_t k = j; k < states; k++) {
+    			sum += fp[i][k] * f[j][k];
+    		}
+    		p[i][j] = sum;
+    		p[j][i] = sum;
+    	}
+    }
+}
+
+//-------------------------------------------------
+float MS_5803_Kalman::toPosition(float mbar) const {
+    if (_mode == MS5803_KALMAN_DEPTH) {
+    	return (mbar - reference) / MBAR_PER_M;
+    }
+    return 44330.8 * (1 - pow(mbar / reference, 0.190263));
+}
+
+//-------------------------------------------------
+float MS_5803_Kalman::slope(float mbar) const {
+    if (_mode == MS5803_KALMAN_DEPTH) {
+    	return 1 / MBAR_PER_M;
+    }
+    if (mbar <= 0) {
+    	return 0;
+    }
+    return -44330.8 * 0.190263 / reference * pow(mbar / reference, 0.190263 - 1);
+}
+
+//-------------------------------------------------
+// Constructor
+MS_5803_KalmanFixed::MS_5803_KalmanFixed(uint16_t processNoise) {
+    q = processNoise;
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_KalmanFixed::reset() {
+    started = false;
+    lastMs = 0;
+    pos = 0;
+    vel = 0;
+    gainMs = 0;
+    gainNoise = 0;
+    alpha = 0;
+    beta = 0;
+}
+
+//-------------------------------------------------
+void MS_5803_KalmanFixed::update(const MS_5803 &sensor, uint32_t ms) {
+    update(ms, sensor.pressureInt(), MS_5803::pressureNoise(sensor.resolution()));
+}
+
+//-------------------------------------------------
+void MS_5803_KalmanFixed::update(uint32_t ms, int32_t pressure, float noise) {
+    if (!started) {
+    	started = true;
+    	lastMs = ms;
+    	pos = pressure << 8;
+    	vel = 0;
+    	return;
+    }
+    uint32_t dtMs = ms - lastMs;
+    lastMs = ms;
+    if (dtMs == 0) {
+    	dtMs = 1;
+    }
+    // Only recompute the gains (in floating point) when the interval has
+    // moved by more than 1/16 or the noise has changed
+    uint32_t drift = dtMs > gainMs ? dtMs - gainMs : gainMs - dtMs;
+    if (noise != gainNoise || drift > gainMs / 16) {
+    	setGains(dtMs, noise);
+    }
+    // Predict: pos += vel * dt, with dt / 1000 as 67109 / 2^26
+    pos += ((int64_t)vel * dtMs * 67109) >> 26;
+    // Correct with the residual
+    int32_t r = (pressure << 8) - pos;
+    pos += ((int64_t)alpha * r) >> 16;
+    vel += ((int64_t)beta * r) >> 16;
+}
+
+//-------------------------------------------------
+// Steady-state gains of the position/velocity Kalman filter with white 
+// random acceleration, from the tracking index (Kalata, 1984). beta is 
+// stored divided by the interval in s, ready to scale the residual into a
+// rate.
+void MS_5803_KalmanFixed::setGains(uint32_t dtMs, float noise) {
+    gainMs = dtMs;
+    gainNoise = noise;
+    float dt = dtMs / 1000.0;
+    // Measurement noise in 0.01 mbar, including rounding
+    float sigma = sqrt(noise * noise * 10000 + 1.0 / 12);
+    float lambda = q * dt * dt / sigma;
+    float r = (4 + lambda - sqrt(8 * lambda + lambda * lambda)) / 4;
+    alpha = (1 - r * r) * 65536;
+    beta = 2 * (1 - r) * (1 - r) / dt * 65536;
+}
@@ -0,0 +1,111 @@
+/*
+ *  MS5803_Kalman
+ *  	Kalman filters for the altitude or depth and vertical speed from MS5803
+ *  	pressure readings, with less noise and lag than differentiating and 
+ *  	smoothing pressure() by hand.
+ *
+ *  	MS_5803_Kalman tracks position and velocity, and optionally
+ *  	acceleration, in m and s. The measurement noise is set from the 
+ *  	sensor's oversampling resolution, and the time step from the 
+ *  	timestamps of the readings, so readings may come at any interval. 
+ *  	Each update is a few dozen float operations in constant memory.
+ *
+ *  	MS_5803_KalmanFixed is for MCUs without an FPU (e.g. AVR). It works on
+ *  	pressureInt() in 0.01 mbar with 32-bit integer state, using the 
+ *  	steady-state gains of the position/velocity filter (an alpha-beta 
+ *  	filter). The gains are recomputed only when the interval or the 
+ *  	resolution changes, so most updates use no floating point at all.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_KALMAN__
+#define __MS_5803_KALMAN__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+// What the position is
+#define MS5803_KALMAN_ALTITUDE 0 // m above the reference pressure, in air
+#define MS5803_KALMAN_DEPTH    1 // m below the reference pressure, in sea water
+
+class MS_5803_Kalman {
+public:
+    // 'processNoise' is the RMS of the unmodelled vertical acceleration 
+    // (m/s^2); with 'acceleration' tracked as well, of its rate of change
+    // (m/s^3). Larger values follow changes faster but pass more noise.
+    MS_5803_Kalman(uint8_t mode = MS5803_KALMAN_ALTITUDE, 
+                   float processNoise = 1.0, boolean acceleration = false);
+    // Start again from the next reading
+    void reset();
+    // Pressure (mbar) at altitude or depth 0: sea level pressure, or the 
+    // atmospheric pressure at the surface of the water
+    void setReference(float mbar)   {reference = mbar;}
+    // Add the latest reading of a sensor (after readSensor()), taken at 
+    // time 'ms'
+    void update(const MS_5803 &sensor, uint32_t ms);
+    // Add a position (m) with the given measurement noise variance (m^2)
+    void update(uint32_t ms, float position, float variance);
+    
+    float position() const          {return x[0];}
+    float velocity() const          {return x[1];}
+    float acceleration() const      {return x[2];}
+    // Estimated variances of the position (m^2) and velocity ((m/s)^2)
+    float positionVariance() const  {return p[0][0];}
+    float velocityVariance() const  {return p[1][1];}
+    // Convert a pressure (mbar) to a position, and give the change in 
+    // position per mbar there
+    float toPosition(float mbar) const;
+    float slope(float mbar) const;
+
+private:
+    uint8_t _mode;
+    uint8_t states;
+    float q;
+    float reference;
+    boolean started;
+    uint32_t lastMs;
+    float x[3];
+    float p[3][3];
+    
+    void predict(float dt);
+};
+
+class MS_5803_KalmanFixed {
+public:
+    // 'processNoise' is the RMS of the unmodelled rate of change of the
+    // pressure rate, in 0.01 mbar/s^2 (per unit, about 0.08 m/s^2 in air 
+    // at sea level, or 0.0001 m/s^2 in water).
+    MS_5803_KalmanFixed(uint16_t processNoise = 100);
+    void reset();
+    // Add the latest reading of a sensor (after readSensor()), taken at 
+    // time 'ms'
+    void update(const MS_5803 &sensor, uint32_t ms);
+    // Add a pressure (0.01 mbar) measured with the given RMS noise (mbar)
+    void update(uint32_t ms, int32_t pressure, float noise);
+    
+    // Filtered pressure (0.01 mbar) and its rate of change (0.01 mbar/s)
+    int32_t pressure() const        {return pos >> 8;}
+    int32_t rate() const            {return vel >> 8;}
+
+private:
+    uint16_t q;
+    boolean started;
+    uint32_t lastMs;
+    int32_t pos; // 0.01 mbar, 8 fractional bits
+    int32_t vel; // 0.01 mbar/s, 8 fractional bits
+    // Interval and noise the gains were computed for
+    uint32_t gainMs;
+    float gainNoise;
+    // Gains, 16 fractional bits; beta is per s
+    int32_t alpha;
+    int32_t beta;
+    
+    void setGains(uint32_t dtMs, float noise);
+};
+
+#endif
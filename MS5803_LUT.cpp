@@ -0,0 +1,127 @@
+/*
+ *  MS5803_LUT
+ *  	Lookup table for the temperature side of the MS5803 compensation. 
+ *  	See MS5803_LUT.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_LUT.h"
+#include "MS5803_05.h"
+
+// Segment spans. At least 2^7, so that the products with C3 and C4 at the
+// start of each segment divide exactly; at most 2^16, so that the low bits
+// times a 16-bit coefficient fit in 32 bits.
+#define LUT_MIN_SHIFT 7
+#define LUT_MAX_SHIFT 16
+// dT = D2 - C5 * 2^8 is always within +-2^24
+#define LUT_DT_LIMIT 16777216.0
+
+//-------------------------------------------------
+// Constructor
+MS_5803_LUT::MS_5803_LUT(uint16_t bytes) {
+    _segments = bytes / sizeof(Entry);
+    table = _segments ? new Entry[_segments] : NULL;
+    if (table == NULL) {
+    	_segments = 0;
+    }
+    _shift = 0;
+    dTmin = 0x7FFFFFFF;
+    c3 = c4 = c6 = 0;
+}
+
+//-------------------------------------------------
+// Destructor
+MS_5803_LUT::~MS_5803_LUT() {
+    delete[] table;
+}
+
+//-------------------------------------------------
+boolean MS_5803_LUT::build(const MS_5803 &sensor, float minTempC,
+                           float maxTempC) {
+    uint16_t c1 = sensor.sensorCoeffs[1];
+    uint16_t c2 = sensor.sensorCoeffs[2];
+    c3 = sensor.sensorCoeffs[3];
+    c4 = sensor.sensorCoeffs[4];
+    c6 = sensor.sensorCoeffs[6];
+    if (_segments == 0 || c6 == 0) {
+    	// Nothing to look up: every dT is below the table
+    	dTmin = 0x7FFFFFFF;
+    	return false;
+    }
+    // First order TEMP = 2000 + dT * C6 / 2^23, solved for dT at the ends
+    // of the range. The second order correction only lowers TEMP, so the 
+    // low end is widened by a degree to be safe. With a small C6 the ends 
+    // can be beyond any dT, and beyond 32 bits, so they are clamped first.
+    float perDegree = 100.0 * 8388608.0 / c6;
+    int32_t lo = (int32_t)constrain((minTempC - 21) * perDegree, -LUT_DT_LIMIT, LUT_DT_LIMIT);
+    int32_t hi = (int32_t)constrain((maxTempC - 20) * perDegree, -LUT_DT_LIMIT, LUT_DT_LIMIT) + 1;
+    // Smallest span that covers the range with the segments available
+    _shift = LUT_MIN_SHIFT;
+    while (_shift < LUT_MAX_SHIFT 
+    		&& ((int32_t)_segments << _shift) < hi - lo) {
+    	_shift++;
+    }
+    // Segments start at multiples of their span
+    int32_t span = (int32_t)1 << _shift;
+    dTmin = lo - ((lo % span) + span) % span;
+    for (uint16_t i = 0; i < _segments; i++) {
+    	int64_t dT0 = dTmin + (int64_t)i * span;
+    	// Floor division, so the remainder is positive
+    	int64_t x6 = dT0 * c6;
+    	int64_t q6 = x6 / 8388608;
+    	int64_t r6 = x6 % 8388608;
+    	if (r6 < 0) {
+    		q6--;
+    		r6 += 8388608;
+    	}
+    	table[i].temp = 2000 + (int32_t)q6;
+    	table[i].tempRem = (uint32_t)r6;
+    	table[i].offset = (int64_t)c2 * 262144 + dT0 * c4 / 32;
+    	table[i].sensitivity = (int64_t)c1 * 131072 + dT0 * c3 / 128;
+    }
+    return true;
+}
+
+//-------------------------------------------------
+boolean MS_5803_LUT::lookup(int32_t dT, int32_t &temp, int64_t &offset,
+                            int64_t &sensitivity) const {
+    if (dT < dTmin) {
+    	return false;
+    }
+    uint32_t index = (uint32_t)(dT - dTmin) >> _shift;
+    if (index >= _segments) {
+    	return false;
+    }
+    const Entry &e = table[index];
+    // Low bits of dT within the segment, times each coefficient. The start
+    // of the segment is floor divided; the data sheet's '/' truncates 
+    // toward zero, which is one more for a negative product with a 
+    // remainder.
+    uint32_t low = (uint32_t)(dT - dTmin) & ((1UL << _shift) - 1);
+    boolean negative = dT < 0;
+    uint32_t p6 = low * c6;
+    uint32_t rem6 = (p6 & 0x7FFFFF) + e.tempRem;
+    int32_t t = e.temp + (int32_t)(p6 >> 23) + (int32_t)(rem6 >> 23);
+    if (negative && (rem6 & 0x7FFFFF)) {
+    	t++;
+    }
+    uint32_t p4 = low * c4;
+    uint32_t p3 = low * c3;
+    offset = e.offset + (p4 >> 5) + (negative && (p4 & 0x1F));
+    sensitivity = e.sensitivity + (p3 >> 7) + (negative && (p3 & 0x7F));
+    if (t < 2000) {
+    	// T2 = 3 * dT^2 / 2^33, with |dT| < 2^24 so 3 * |dT| fits in 32 bits
+    	uint32_t absdT = negative ? -dT : dT;
+    	int32_t t2 = ((uint64_t)absdT * (3 * absdT)) >> 33;
+    	offset -= 3 * ((t-2000) * (t-2000)) / 8;
+    	sensitivity -= 7 * ((t-2000) * (t-2000)) / 8;
+    	t = t - t2;
+    }
+    temp = t;
+    return true;
+}
@@ -0,0 +1,72 @@
+/*
+ *  MS5803_LUT
+ *  	Per-device lookup table for the temperature side of the MS5803 
+ *  	compensation. Everything but the final pressure step depends only on
+ *  	D2 (through dT) and the sensor coefficients, so the table holds, for
+ *  	evenly spaced dT values over the operating temperature range, the 
+ *  	first order TEMP, Offset and Sensitivity. A reading is indexed by the
+ *  	upper bits of its offset into the range, and the low bits are added 
+ *  	back with 32-bit multiplies, with the truncations of the data sheet
+ *  	math done exactly. Below 20 C the second order terms are then one
+ *  	32 x 32 bit multiply and two 32-bit ones. The pressure step is one 
+ *  	multiply and shift, so results are bit-exact with the direct 
+ *  	computation.
+ *
+ *  	Each segment takes 24 bytes, so a 1-4 KB table has 42-170 segments.
+ *  	Readings outside the table's range fall back to the direct 
+ *  	computation.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_LUT__
+#define __MS_5803_LUT__
+
+#include <Arduino.h>
+
+class MS_5803;
+
+class MS_5803_LUT {
+public:
+    // Size of the table in bytes
+    MS_5803_LUT(uint16_t bytes = 2048);
+    ~MS_5803_LUT();
+    MS_5803_LUT(const MS_5803_LUT &) = delete;
+    MS_5803_LUT &operator=(const MS_5803_LUT &) = delete;
+    // Fill the table for a sensor (with its coefficients read) over a range
+    // of temperatures in degrees C. A small table may not span the whole
+    // range, in which case it covers from minTempC up. Returns false if the 
+    // table couldn't be allocated or the sensor's C6 is 0.
+    boolean build(const MS_5803 &sensor, float minTempC = -40, 
+                  float maxTempC = 85);
+    // Temperature side of the compensation for one dT: second order 
+    // corrected TEMP, Offset and Sensitivity. Returns false if dT is out 
+    // of the table's range.
+    boolean lookup(int32_t dT, int32_t &temp, int64_t &offset,
+                   int64_t &sensitivity) const;
+    // Number of segments and the dT span of each (2^shift)
+    uint16_t segments() const       {return _segments;}
+    uint8_t shift() const           {return _shift;}
+
+private:
+    struct Entry {
+    	int64_t offset;      // C2 * 2^18 + dT * C4 / 2^5 at the start
+    	int64_t sensitivity; // C1 * 2^17 + dT * C3 / 2^7
+    	int32_t temp;        // 2000 + floor(dT * C6 / 2^23)
+    	uint32_t tempRem;    // and the remainder of that division
+    };
+    Entry *table;
+    uint16_t _segments;
+    uint8_t _shift;
+    // dT at the start of the first segment, a multiple of 2^shift
+    int32_t dTmin;
+    uint16_t c3;
+    uint16_t c4;
+    uint16_t c6;
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ *  MS5803_Leak
+ *  	Robust leak rate estimation for sealed housings. See MS5803_Leak.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Leak.h"
+
+// 0C and the reference temperature of 20C, in 0.01 K
+#define ZERO_CELSIUS 27315
+#define REFERENCE_KELVIN 29315.0
+// Smallest scale of the residuals: the 0.01 mbar resolution
+#define MIN_SIGMA 0.01
+// Weight of each new residual in the scale estimate
+#define SIGMA_RATE 0.01
+// Mean absolute deviation to standard deviation for normal residuals
+#define MAD_TO_SIGMA 1.2533
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Leak::MS_5803_Leak(float halfLifeHours, float huber) {
+    decayPerHour = halfLifeHours > 0 ? log(2.0) / halfLifeHours : 0;
+    _huber = huber;
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_Leak::reset() {
+    n = 0;
+    startSeconds = 0;
+    origin = 0;
+    lastHours = 0;
+    sw = st = sy = stt = sty = syy = 0;
+    sigma = 0;
+}
+
+//-------------------------------------------------
+float MS_5803_Leak::normalise(int32_t pressure, int32_t temperature) {
+    return pressure * (float)(REFERENCE_KELVIN / 100.0) 
+    		/ (temperature + ZERO_CELSIUS);
+}
+
+//-------------------------------------------------
+void MS_5803_Leak::add(const MS_5803 &sensor, uint32_t seconds) {
+    add(seconds, sensor.pressureInt(), sensor.temperatureInt());
+}
+
+//-------------------------------------------------
+void MS_5803_Leak::add(uint32_t seconds, int32_t pressure, int32_t temperature) {
+    float y = normalise(pressure, temperature);
+    if (n == 0) {
+    	startSeconds = seconds;
+    	origin = y;
+    }
+    float t = (seconds - startSeconds) / 3600.0;
+    y -= origin;
+    // Weight the reading by its residual from the fit so far (Huber), and
+    // update the robust scale from the residual
+    float w = 1;
+    float a, b;
+    if (fit(a, b)) {
+    	float r = fabs(y - a - b * t);
+    	float limit = _huber * max(sigma, (float)MIN_SIGMA);
+    	if (r > limit) {
+    		w = limit / r;
+    	}
+    	// Clip the residual fed to the scale so spikes can't inflate it
+    	sigma += SIGMA_RATE * (MAD_TO_SIGMA * min(r, 3 * limit) - sigma);
+    }
+    else if (n > 0) {
+    	sigma = max(sigma, (float)(MAD_TO_SIGMA * fabs(y - sy / sw)));
+    }
+    // Forget older readings
+    if (decayPerHour > 0 && t > lastHours) {
+    	float keep = exp(-decayPerHour * (t - lastHours));
+    	sw *= keep;
+    	st *= keep;
+    	sy *= keep;
+    	stt *= keep;
+    	sty *= keep;
+    	syy *= keep;
+    }
+    lastHours = t;
+    sw += w;
+    st += w * t;
+    sy += w * y;
+    stt += w * t * t;
+    sty += w * t * y;
+    syy += w * y * y;
+    n++;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Leak::fit(float &a, float &b) const {
+    if (n < 3 || sw <= 0) {
+    	return false;
+    }
+    float meanT = st / sw;
+    float varT = stt / sw - meanT * meanT;
+    if (varT <= 0) {
+    	return false;
+    }
+    b = (sty / sw - meanT * sy / sw) / varT;
+    a = sy / sw - b * meanT;
+    return true;
+}
+
+//-------------------------------------------------
+float MS_5803_Leak::level() const {
+    float a, b;
+    if (!fit(a, b)) {
+    	return n ? origin + sy / sw : NAN;
+    }
+    return origin + a + b * lastHours;
+}
+
+//-------------------------------------------------
+float MS_5803_Leak::rate() const {
+    float a, b;
+    return fit(a, b) ? b : NAN;
+}
+
+//-------------------------------------------------
+float MS_5803_Leak::rateError() const {
+    float a, b;
+    if (!fit(a, b) || n < 4) {
+    	return NAN;
+    }
+    // Residual variance of the weighted fit, over the spread of the times
+    float meanT = st / sw;
+    float meanY = sy / sw;
+    float varT = stt / sw - meanT * meanT;
+    float varY = syy / sw - meanY * meanY;
+    float residual = max(varY - b * b * varT, (float)0);
+    // Effective number of readings, for weights that decay or down-weight
+    float effective = min((float)n, sw);
+    if (effective <= 2) {
+    	return NAN;
+    }
+    return sqrt(residual / (varT * (effective - 2)));
+}
+
+//-------------------------------------------------
+float MS_5803_Leak::timeTo(float mbar) const {
+    float slope = rate();
+    if (isnan(slope) || slope == 0) {
+    	return NAN;
+    }
+    float hours = (mbar - level()) / slope;
+    return hours >= 0 ? hours : NAN;
+}
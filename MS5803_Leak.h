@@ -0,0 +1,79 @@
+/*
+ *  MS5803_Leak
+ *  	Leak rate of a sealed housing from the MS5803 inside it. The pressure
+ *  	of the trapped gas follows its absolute temperature, which hides slow
+ *  	leaks, so each reading is first normalised to 20C by the gas law 
+ *  	using the same reading's integer temperature (P * 293.15K / T). The
+ *  	normalised pressure is then fitted against time by a robust (Huber)
+ *  	weighted linear regression that is updated with each reading, so 
+ *  	spikes and the odd bad reading don't pull the rate. The fit gives the
+ *  	leak rate, its standard error, and the time until the normalised 
+ *  	pressure reaches a threshold.
+ *
+ *  	Each reading costs a constant few dozen float operations, and memory
+ *  	is constant. Old readings can be forgotten with a half-life, so that
+ *  	a leak that starts late is picked up.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_LEAK__
+#define __MS_5803_LEAK__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+class MS_5803_Leak {
+public:
+    // Readings lose half their weight every 'halfLifeHours' (0 to keep them
+    // all). Residuals beyond 'huber' times the robust scale of the 
+    // residuals are down-weighted.
+    MS_5803_Leak(float halfLifeHours = 0, float huber = 1.345);
+    // Forget all readings
+    void reset();
+    // Add the latest reading of a sensor (after readSensor()), taken at 
+    // time 'seconds'
+    void add(const MS_5803 &sensor, uint32_t seconds);
+    // Add a pressure (0.01 mbar) and temperature (0.01 C) taken at 'seconds'
+    void add(uint32_t seconds, int32_t pressure, int32_t temperature);
+    // Pressure normalised to 20C, mbar
+    static float normalise(int32_t pressure, int32_t temperature);
+    
+    uint32_t count() const          {return n;}
+    // Fitted normalised pressure (mbar) at the last reading
+    float level() const;
+    // Leak rate in mbar per hour of normalised pressure (negative when gas
+    // leaks out), and its standard error. A leak is significant when the 
+    // rate is more than about 3 standard errors from 0. The error assumes
+    // independent readings, so it is optimistic over short records where
+    // slow (1/f) noise dominates.
+    float rate() const;
+    float rateError() const;
+    // Hours from the last reading until the normalised pressure reaches
+    // 'mbar' at the fitted rate, or NAN if it is not heading there
+    float timeTo(float mbar) const;
+    // Robust scale of the residuals, mbar
+    float scale() const             {return sigma;}
+
+private:
+    float decayPerHour;
+    float _huber;
+    uint32_t n;
+    // Time (s) and normalised pressure (mbar) of the first reading; the
+    // sums are relative to them
+    uint32_t startSeconds;
+    float origin;
+    float lastHours;
+    // Weighted sums of 1, t, y, t^2, t y and y^2 (t in hours)
+    float sw, st, sy, stt, sty, syy;
+    float sigma;
+    
+    // Intercept and slope of the current fit; false if not yet determined
+    boolean fit(float &a, float &b) const;
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ *  MS5803_MultiRate
+ *  	Cascaded CIC + FIR decimation into several streams. See 
+ *  	MS5803_MultiRate.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_MultiRate.h"
+
+// Droop compensation FIR [c, 1 - 2c, c] with c = -11/64, in 64ths. Flat 
+// within 2.5% up to a quarter of the output rate for a 3rd order CIC.
+#define FIR_EDGE (-11)
+#define FIR_CENTRE 86
+#define FIR_SHIFT 6
+
+//-------------------------------------------------
+// Constructor
+MS_5803_MultiRate::MS_5803_MultiRate() {
+    _stages = 0;
+    reset();
+}
+
+//-------------------------------------------------
+int8_t MS_5803_MultiRate::addStage(uint16_t factor) {
+    if (_stages >= MS5803_MULTIRATE_STAGES || factor == 0) {
+    	return -1;
+    }
+    stage[_stages].factor = factor;
+    _stages++;
+    reset();
+    return _stages - 1;
+}
+
+//-------------------------------------------------
+void MS_5803_MultiRate::reset() {
+    started = false;
+    origin = 0;
+    for (uint8_t i = 0; i < MS5803_MULTIRATE_STAGES; i++) {
+    	Stage &s = stage[i];
+    	s.phase = 0;
+    	for (uint8_t j = 0; j < MS5803_MULTIRATE_ORDER; j++) {
+    		s.integrators[j] = 0;
+    		s.combs[j] = 0;
+    	}
+    	s.history[0] = 0;
+    	s.history[1] = 0;
+    	s.output = 0;
+    	s.count = 0;
+    }
+}
+
+//-------------------------------------------------
+uint8_t MS_5803_MultiRate::add(int32_t value) {
+    if (!started) {
+    	started = true;
+    	origin = value;
+    }
+    // Each stage's output is the next one's input; stop at the first
+    // stage without a new output.
+    int32_t in = value - origin;
+    uint8_t ready = 0;
+    for (uint8_t i = 0; i < _stages; i++) {
+    	int32_t out;
+    	if (!step(stage[i], in, out)) {
+    		break;
+    	}
+    	ready |= 1 << i;
+    	in = out;
+    }
+    return ready;
+}
+
+//-------------------------------------------------
+boolean MS_5803_MultiRate::step(Stage &s, int32_t in, int32_t &out) {
+    if (s.factor == 1) {
+    	s.output = in;
+    	s.count++;
+    	out = in;
+    	return true;
+    }
+    // Integrators at the input rate
+    uint64_t x = (uint64_t)(int64_t)in;
+    for (uint8_t j = 0; j < MS5803_MULTIRATE_ORDER; j++) {
+    	s.integrators[j] += x;
+    	x = s.integrators[j];
+    }
+    if (++s.phase < s.factor) {
+    	return false;
+    }
+    s.phase = 0;
+    // Combs at the output rate, then remove the gain of factor^3 
+    for (uint8_t j = 0; j < MS5803_MULTIRATE_ORDER; j++) {
+    	uint64_t delayed = s.combs[j];
+    	s.combs[j] = x;
+    	x -= delayed;
+    }
+    int64_t gain = (int64_t)s.factor * s.factor * s.factor;
+    int64_t sum = (int64_t)x;
+    int32_t cic = (sum + (sum >= 0 ? gain / 2 : -gain / 2)) / gain;
+    int32_t fir = ((int32_t)FIR_EDGE * (s.history[0] + cic) 
+    		+ (int32_t)FIR_CENTRE * s.history[1] + (1 << (FIR_SHIFT - 1))) >> FIR_SHIFT;
+    s.history[0] = s.history[1];
+    s.history[1] = cic;
+    s.output = fir;
+    s.count++;
+    out = fir;
+    return true;
+}
+
+//-------------------------------------------------
+int32_t MS_5803_MultiRate::output(uint8_t i) const {
+    return i < _stages && stage[i].count ? origin + stage[i].output : 0;
+}
+
+//-------------------------------------------------
+uint32_t MS_5803_MultiRate::count(uint8_t i) const {
+    return i < _stages ? stage[i].count : 0;
+}
+
+//-------------------------------------------------
+uint32_t MS_5803_MultiRate::ratio(uint8_t i) const {
+    uint32_t r = 1;
+    for (uint8_t j = 0; j <= i && j < _stages; j++) {
+    	r *= stage[j].factor;
+    }
+    return r;
+}
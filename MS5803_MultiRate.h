@@ -0,0 +1,79 @@
+/*
+ *  MS5803_MultiRate
+ *  	Several decimated streams from one stream of readings, e.g. 50 Hz for
+ *  	event detection, 1 Hz for dashboards and one a minute for archives. 
+ *  	The stages form a cascade: each decimates the output of the one 
+ *  	before, so the filtering done for a fast stream is shared with the 
+ *  	slower ones, and adding a slow stream costs almost nothing per 
+ *  	reading.
+ *
+ *  	Each stage is a 3rd order CIC decimator (integrators at the input 
+ *  	rate, combs at the output rate, no multiplies) followed by a 3-tap 
+ *  	FIR at the output rate that compensates the droop of the CIC up to a
+ *  	quarter of the output rate. The CIC has nulls at every multiple of the
+ *  	output rate, which suppresses what would alias onto low frequencies;
+ *  	near half the output rate the rejection is weaker.
+ *
+ *  	Values are in 0.01 mbar as from MS_5803::pressureInt(), kept 
+ *  	relative to the first reading so that the CIC gain of factor^3 can't 
+ *  	overflow.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_MULTIRATE__
+#define __MS_5803_MULTIRATE__
+
+#include <Arduino.h>
+
+#define MS5803_MULTIRATE_STAGES 4
+#define MS5803_MULTIRATE_ORDER 3
+
+class MS_5803_MultiRate {
+public:
+    MS_5803_MultiRate();
+    // Add a stage that decimates the output of the last stage (or the 
+    // readings, for the first) by 'factor'. A factor of 1 passes the 
+    // readings through unfiltered. Returns the stage number, or -1 if there
+    // are already MS5803_MULTIRATE_STAGES stages or the factor is 0.
+    int8_t addStage(uint16_t factor);
+    // Forget the readings, keeping the stages
+    void reset();
+    // Add a reading. Returns a bit for each stage (bit 0 for stage 0) that
+    // has a new output.
+    uint8_t add(int32_t value);
+    
+    uint8_t stages() const          {return _stages;}
+    // Latest output of a stage, 0.01 mbar
+    int32_t output(uint8_t stage) const;
+    // Outputs produced by a stage
+    uint32_t count(uint8_t stage) const;
+    // Input readings per output of a stage
+    uint32_t ratio(uint8_t stage) const;
+
+private:
+    struct Stage {
+    	uint16_t factor;
+    	uint16_t phase;
+    	// Integrators and comb delays, wrapping modulo 2^64
+    	uint64_t integrators[MS5803_MULTIRATE_ORDER];
+    	uint64_t combs[MS5803_MULTIRATE_ORDER];
+    	// Last two CIC outputs for the FIR
+    	int32_t history[2];
+    	int32_t output;
+    	uint32_t count;
+    };
+    Stage stage[MS5803_MULTIRATE_STAGES];
+    uint8_t _stages;
+    boolean started;
+    int32_t origin;
+    
+    // Run one input through a stage; returns true with its output
+    static boolean step(Stage &s, int32_t in, int32_t &out);
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ *  MS5803_Publish
+ *  	Streaming of readings to several clients with bounded queues. See 
+ *  	MS5803_Publish.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Publish.h"
+#include "MS5803_Transfer.h"
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Publisher::MS_5803_Publisher() {
+    for (uint8_t i = 0; i < MS5803_PUBLISH_CLIENTS; i++) {
+    	clients[i].active = false;
+    	clients[i].queue = NULL;
+    }
+    for (uint8_t i = 0; i < MS5803_PUBLISH_SENSORS; i++) {
+    	sequence[i] = 0;
+    }
+}
+
+MS_5803_Publisher::~MS_5803_Publisher() {
+    for (uint8_t i = 0; i < MS5803_PUBLISH_CLIENTS; i++) {
+    	delete[] clients[i].queue;
+    }
+}
+
+//-------------------------------------------------
+int8_t MS_5803_Publisher::subscribe(Print &client, uint16_t records, 
+                                    uint32_t sensors, uint16_t decimation,
+                                    uint8_t policy, uint16_t burst) {
+    for (uint8_t i = 0; i < MS5803_PUBLISH_CLIENTS; i++) {
+    	Client &c = clients[i];
+    	if (c.active) {
+    		continue;
+    	}
+    	delete[] c.queue;
+    	c.size = records ? records : 1;
+    	c.queue = new uint8_t[(uint32_t)c.size * MS5803_PUBLISH_RECORD];
+    	if (c.queue == NULL) {
+    		return -1;
+    	}
+    	c.out = &client;
+    	c.head = 0;
+    	c.count = 0;
+    	c.partial = 0;
+    	c.sensors = sensors;
+    	c.decimation = decimation ? decimation : 1;
+    	c.policy = policy;
+    	c.burst = burst;
+    	c.active = true;
+    	c.disconnected = false;
+    	c.sent = 0;
+    	c.dropped = 0;
+    	return i;
+    }
+    return -1;
+}
+
+//-------------------------------------------------
+void MS_5803_Publisher::unsubscribe(int8_t id) {
+    if (valid(id)) {
+    	clients[id].active = false;
+    	delete[] clients[id].queue;
+    	clients[id].queue = NULL;
+    }
+}
+
+//-------------------------------------------------
+boolean MS_5803_Publisher::connected(int8_t id) const {
+    return valid(id) && !clients[id].disconnected;
+}
+
+//-------------------------------------------------
+void MS_5803_Publisher::publish(uint8_t sensor, uint32_t ms, int32_t pressure,
+                                int32_t temperature) {
+    if (sensor >= MS5803_PUBLISH_SENSORS) {
+    	return;
+    }
+    uint16_t number = sequence[sensor]++;
+    uint8_t record[MS5803_PUBLISH_RECORD];
+    boolean built = false;
+    for (uint8_t i = 0; i < MS5803_PUBLISH_CLIENTS; i++) {
+    	Client &c = clients[i];
+    	if (!c.active || c.disconnected || !(c.sensors & (1UL << sensor)) 
+    			|| number % c.decimation) {
+    		continue;
+    	}
+    	// Build the record once, for the first client that wants it
+    	if (!built) {
+    		built = true;
+    		record[0] = 0xA5;
+    		record[1] = sensor;
+    		uint32_t fields[3] = {ms, (uint32_t)pressure, (uint32_t)temperature};
+    		for (uint8_t f = 0; f < 3; f++) {
+    			for (uint8_t b = 0; b < 4; b++) {
+    				record[2 + f * 4 + b] = fields[f] >> (8 * b);
+    			}
+    		}
+    		uint16_t crc = MS_5803_Transfer::crc16(record, 14);
+    		record[14] = crc;
+    		record[15] = crc >> 8;
+    	}
+    	if (c.count == c.size) {
+    		if (c.policy == MS5803_PUBLISH_DISCONNECT) {
+    			c.disconnected = true;
+    			c.count = 0;
+    			c.partial = 0;
+    			c.dropped++;
+    			continue;
+    		}
+    		c.dropped++;
+    		if (c.partial) {
+    			// The oldest record is partly written and has to be 
+    			// finished, so the one after it goes instead. With room for
+    			// only one record, the new one goes.
+    			if (c.size == 1) {
+    				continue;
+    			}
+    			uint16_t next = (c.head + 1) % c.size;
+    			memcpy(c.queue + (uint32_t)next * MS5803_PUBLISH_RECORD, 
+    			       c.queue + (uint32_t)c.head * MS5803_PUBLISH_RECORD, 
+    			       MS5803_PUBLISH_RECORD);
+    		}
+    		c.head = (c.head + 1) % c.size;
+    		c.count--;
+    	}
+    	uint16_t tail = (c.head + c.count) % c.size;
+    	memcpy(c.queue + (uint32_t)tail * MS5803_PUBLISH_RECORD, record, 
+    	       MS5803_PUBLISH_RECORD);
+    	c.count++;
+    }
+}
+
+//-------------------------------------------------
+void MS_5803_Publisher::pump() {
+    for (uint8_t i = 0; i < MS5803_PUBLISH_CLIENTS; i++) {
+    	Client &c = clients[i];
+    	if (!c.active || c.disconnected) {
+    		continue;
+    	}
+    	// Offer up to the end of a whole record, in at most two writes: up 
+    	// to the end of the queue, then from its start. The client may take
+    	// fewer bytes; the rest waits for the next pump().
+    	int room = c.out->availableForWrite();
+    	if (room <= 0) {
+    		room = c.burst;
+    	}
+    	uint32_t records = min((uint32_t)c.count, 
+    	                       ((uint32_t)room + c.partial) / MS5803_PUBLISH_RECORD);
+    	uint32_t bytes = records ? records * MS5803_PUBLISH_RECORD - c.partial : 0;
+    	uint32_t end = (uint32_t)c.size * MS5803_PUBLISH_RECORD;
+    	while (bytes > 0) {
+    		uint32_t offset = (uint32_t)c.head * MS5803_PUBLISH_RECORD + c.partial;
+    		uint32_t run = min(bytes, end - offset);
+    		size_t written = c.out->write(c.queue + offset, run);
+    		if (written > run) {
+    			written = run;
+    		}
+    		uint32_t done = c.partial + written;
+    		uint16_t whole = done / MS5803_PUBLISH_RECORD;
+    		c.partial = done % MS5803_PUBLISH_RECORD;
+    		c.head = (c.head + whole) % c.size;
+    		c.count -= whole;
+    		c.sent += whole;
+    		bytes -= written;
+    		if (written < run) {
+    			break;
+    		}
+    	}
+    }
+}
+
+//-------------------------------------------------
+uint16_t MS_5803_Publisher::queued(int8_t id) const {
+    return valid(id) ? clients[id].count : 0;
+}
+
+uint32_t MS_5803_Publisher::sent(int8_t id) const {
+    return valid(id) ? clients[id].sent : 0;
+}
+
+uint32_t MS_5803_Publisher::dropped(int8_t id) const {
+    return valid(id) ? clients[id].dropped : 0;
+}
@@ -0,0 +1,98 @@
+/*
+ *  MS5803_Publish
+ *  	Streams readings to several clients at once (e.g. WiFiClients of a
+ *  	gateway, serial ports) without letting a slow client stall sampling.
+ *  	Each client chooses the sensors it wants and a decimation, and has a
+ *  	bounded queue of its own. publish() only queues, in O(clients); 
+ *  	pump() writes each client as much of its queue as it has room for, 
+ *  	in at most two writes; when a client takes fewer bytes than offered,
+ *  	the next pump() carries on from the byte it stopped at. When a 
+ *  	client's queue is full, either its oldest unstarted records are 
+ *  	dropped or it is disconnected, as chosen per client.
+ *
+ *  	Each reading is a 16-byte record: 0xA5, sensor, ms (4 bytes), 
+ *  	pressure (4, 0.01 mbar), temperature (4, 0.01 C), CRC-16/CCITT of 
+ *  	the bytes before it (2), all little-endian.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_PUBLISH__
+#define __MS_5803_PUBLISH__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+#define MS5803_PUBLISH_CLIENTS 8
+#define MS5803_PUBLISH_SENSORS 32
+#define MS5803_PUBLISH_RECORD 16
+// What to do when a client's queue is full
+#define MS5803_PUBLISH_DROP_OLDEST 0
+#define MS5803_PUBLISH_DISCONNECT  1
+
+class MS_5803_Publisher {
+public:
+    MS_5803_Publisher();
+    ~MS_5803_Publisher();
+    MS_5803_Publisher(const MS_5803_Publisher &) = delete;
+    MS_5803_Publisher &operator=(const MS_5803_Publisher &) = delete;
+    // Add a client with a queue of 'records' readings. 'sensors' has a bit
+    // for each sensor (0-31) it wants; it gets every 'decimation'th reading
+    // of each. pump() writes what the client's availableForWrite() allows,
+    // or up to 'burst' bytes if it reports 0 (for clients that don't 
+    // report their free space). Returns the client number, or -1 if there
+    // is no free slot or memory.
+    int8_t subscribe(Print &client, uint16_t records = 32, 
+                     uint32_t sensors = 0xFFFFFFFF, uint16_t decimation = 1,
+                     uint8_t policy = MS5803_PUBLISH_DROP_OLDEST, 
+                     uint16_t burst = 0);
+    void unsubscribe(int8_t id);
+    // False once a client has been disconnected for falling behind (or was
+    // never subscribed); close its connection and unsubscribe it.
+    boolean connected(int8_t id) const;
+    // Queue a reading for the clients that want it
+    void publish(uint8_t sensor, uint32_t ms, int32_t pressure, 
+                 int32_t temperature);
+    void publish(uint8_t sensor, const MS_5803 &reading, uint32_t ms) {
+        publish(sensor, ms, reading.pressureInt(), reading.temperatureInt());
+    }
+    // Write queued readings to the clients; call often from loop()
+    void pump();
+    
+    // Per client: readings queued, written in full and dropped
+    uint16_t queued(int8_t id) const;
+    uint32_t sent(int8_t id) const;
+    uint32_t dropped(int8_t id) const;
+
+private:
+    struct Client {
+    	Print *out;
+    	uint8_t *queue;
+    	uint16_t size;
+    	uint16_t head;
+    	uint16_t count;
+    	// Bytes of the record at head already written
+    	uint8_t partial;
+    	uint32_t sensors;
+    	uint16_t decimation;
+    	uint8_t policy;
+    	uint16_t burst;
+    	boolean active;
+    	boolean disconnected;
+    	uint32_t sent;
+    	uint32_t dropped;
+    };
+    Client clients[MS5803_PUBLISH_CLIENTS];
+    // Readings published per sensor, for the decimation
+    uint16_t sequence[MS5803_PUBLISH_SENSORS];
+    
+    boolean valid(int8_t id) const {
+        return id >= 0 && id < MS5803_PUBLISH_CLIENTS && clients[id].active;
+    }
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ *  MS5803_Query
+ *  	Filtering and aggregation of Arrow reading logs. See MS5803_Query.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Query.h"
+
+// Largest batch, so that a column fits in one read
+#define QUERY_MAX_ROWS 16383
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Query::MS_5803_Query(uint16_t maxRows, uint16_t groups) {
+    capacity = min(max(maxRows, (uint16_t)1), (uint16_t)QUERY_MAX_ROWS);
+    maxGroups = groups ? groups : 1;
+    ms = new uint32_t[capacity];
+    sensors = new uint8_t[capacity];
+    pressures = new int32_t[capacity];
+    temperatures = new int32_t[capacity];
+    keep = new uint8_t[capacity];
+    results = new MS_5803_QueryGroup[maxGroups];
+    fromMs = 0;
+    toMs = 0xFFFFFFFF;
+    pressureMin = temperatureMin = (int32_t)0x80000000;
+    pressureMax = temperatureMax = 0x7FFFFFFF;
+    sensorMask = 0xFFFFFFFF;
+    bucketMs = 0;
+    column = MS5803_ARROW_PRESSURE;
+    skipping = true;
+    clear();
+}
+
+MS_5803_Query::~MS_5803_Query() {
+    delete[] ms;
+    delete[] sensors;
+    delete[] pressures;
+    delete[] temperatures;
+    delete[] keep;
+    delete[] results;
+}
+
+//-------------------------------------------------
+void MS_5803_Query::whereTime(uint32_t from, uint32_t to) {
+    fromMs = from;
+    toMs = to;
+}
+
+void MS_5803_Query::wherePressure(int32_t min, int32_t max) {
+    pressureMin = min;
+    pressureMax = max;
+}
+
+void MS_5803_Query::whereTemperature(int32_t min, int32_t max) {
+    temperatureMin = min;
+    temperatureMax = max;
+}
+
+void MS_5803_Query::whereSensors(uint32_t mask) {
+    sensorMask = mask;
+}
+
+void MS_5803_Query::groupBy(uint32_t bucket, uint8_t aggregate) {
+    bucketMs = bucket;
+    column = aggregate == MS5803_ARROW_TEMPERATURE ? aggregate : MS5803_ARROW_PRESSURE;
+}
+
+//-------------------------------------------------
+void MS_5803_Query::clear() {
+    used = 0;
+    last = 0;
+    full = false;
+    _blocksRead = 0;
+    _blocksSkipped = 0;
+    _matched = 0;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Query::scan(MS_5803_BlockSource &log, MS_5803_BlockSource &index) {
+    boolean ok = true;
+    MS_5803_BlockStats stats;
+    for (uint32_t at = 0; at + sizeof(stats) <= index.size(); at += sizeof(stats)) {
+    	if (index.read(at, (uint8_t *)&stats, sizeof(stats)) != sizeof(stats)) {
+    		return false;
+    	}
+    	if (skipping && excluded(stats)) {
+    		_blocksSkipped++;
+    		continue;
+    	}
+    	if (stats.rows > capacity || !scanBlock(log, stats)) {
+    		ok = false;
+    		continue;
+    	}
+    	_blocksRead++;
+    }
+    return ok && !full;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Query::excluded(const MS_5803_BlockStats &stats) const {
+    return stats.rows == 0 || stats.msMax < fromMs || stats.msMin > toMs
+    		|| !(stats.sensors & sensorMask)
+    		|| stats.pressureMax < pressureMin || stats.pressureMin > pressureMax
+    		|| stats.temperatureMax < temperatureMin
+    		|| stats.temperatureMin > temperatureMax;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Query::readColumn(MS_5803_BlockSource &log,
+                                  const MS_5803_BlockStats &stats,
+                                  uint8_t col, void *data, uint8_t width) {
+    uint16_t length = stats.rows * width;
+    uint32_t offset = stats.offset + MS_5803_ArrowWriter::columnOffset(col, stats.rows);
+    return log.read(offset, (uint8_t *)data, length) == length;
+}
+
+//-------------------------------------------------
+// Reads the columns, builds the selection one range at a time, leaving out
+// the ranges the statistics show every reading passes, then aggregates the
+// selected readings.
+boolean MS_5803_Query::scanBlock(MS_5803_BlockSource &log,
+                                 const MS_5803_BlockStats &stats) {
+    uint16_t rows = stats.rows;
+    if (!readColumn(log, stats, MS5803_ARROW_MS, ms, 4)
+    		|| !readColumn(log, stats, MS5803_ARROW_SENSOR, sensors, 1)
+    		|| !readColumn(log, stats, MS5803_ARROW_PRESSURE, pressures, 4)
+    		|| !readColumn(log, stats, MS5803_ARROW_TEMPERATURE, temperatures, 4)) {
+    	return false;
+    }
+    memset(keep, 1, rows);
+    if (stats.temperatureMin < temperatureMin || stats.temperatureMax > temperatureMax) {
+    	for (uint16_t i = 0; i < rows; i++) {
+    		keep[i] &= (temperatures[i] >= temperatureMin) & (temperatures[i] <= temperatureMax);
+    	}
+    }
+    if (stats.pressureMin < pressureMin || stats.pressureMax > pressureMax) {
+    	for (uint16_t i = 0; i < rows; i++) {
+    		keep[i] &= (pressures[i] >= pressureMin) & (pressures[i] <= pressureMax);
+    	}
+    }
+    if (stats.msMin < fromMs || stats.msMax > toMs) {
+    	for (uint16_t i = 0; i < rows; i++) {
+    		keep[i] &= (ms[i] >= fromMs) & (ms[i] <= toMs);
+    	}
+    }
+    if ((stats.sensors & sensorMask) != stats.sensors) {
+    	for (uint16_t i = 0; i < rows; i++) {
+    		keep[i] &= (sensorMask >> min(sensors[i], (uint8_t)31)) & 1;
+    	}
+    }
+    const int32_t *values = column == MS5803_ARROW_TEMPERATURE ? temperatures : pressures;
+    for (uint16_t i = 0; i < rows; i++) {
+    	if (!keep[i]) {
+    		continue;
+    	}
+    	MS_5803_QueryGroup *g = find(sensors[i], bucketMs ? ms[i] / bucketMs : 0);
+    	if (g == NULL) {
+    		continue;
+    	}
+    	int32_t v = values[i];
+    	if (g->count == 0) {
+    		g->min = g->max = v;
+    	}
+    	g->min = min(g->min, v);
+    	g->max = max(g->max, v);
+    	g->sum += v;
+    	g->count++;
+    	_matched++;
+    }
+    return true;
+}
+
+//-------------------------------------------------
+MS_5803_QueryGroup *MS_5803_Query::find(uint8_t sensor, uint32_t bucket) {
+    // Logs are in time order, so the group of the last match, or one of
+    // the latest, is the likely one
+    if (used && results[last].sensor == sensor && results[last].bucket == bucket) {
+    	return &results[last];
+    }
+    for (uint16_t i = used; i-- > 0;) {
+    	if (results[i].sensor == sensor && results[i].bucket == bucket) {
+    		last = i;
+    		return &results[i];
+    	}
+    }
+    if (used == maxGroups) {
+    	full = true;
+    	return NULL;
+    }
+    MS_5803_QueryGroup &g = results[used];
+    g.sensor = sensor;
+    g.bucket = bucket;
+    g.count = 0;
+    g.min = 0;
+    g.max = 0;
+    g.sum = 0;
+    last = used++;
+    return &g;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Query::merge(const MS_5803_Query &other) {
+    for (uint16_t i = 0; i < other.used; i++) {
+    	const MS_5803_QueryGroup &o = other.results[i];
+    	MS_5803_QueryGroup *g = find(o.sensor, o.bucket);
+    	if (g == NULL) {
+    		continue;
+    	}
+    	if (g->count == 0) {
+    		g->min = o.min;
+    		g->max = o.max;
+    	}
+    	g->min = min(g->min, o.min);
+    	g->max = max(g->max, o.max);
+    	g->sum += o.sum;
+    	g->count += o.count;
+    }
+    _blocksRead += other._blocksRead;
+    _blocksSkipped += other._blocksSkipped;
+    _matched += other._matched;
+    return !full;
+}
@@ -0,0 +1,121 @@
+/*
+ *  MS5803_Query
+ *  	Filters and aggregates readings logged with MS5803_Arrow.h, e.g.
+ *  	"the highest pressure per sensor per day where the temperature is
+ *  	below 5 C", on the device or in a host build. Readings are kept if
+ *  	they are within every range set with the where...() calls, and
+ *  	grouped by sensor and time bucket into the count, minimum, maximum
+ *  	and mean of one column.
+ *
+ *  	The batches are read through the index stream that the writer's
+ *  	setIndex() fills. A batch whose statistics rule out every reading is
+ *  	not read at all, and a range its statistics show every reading
+ *  	passes is not tested. The other ranges are tested a column at a
+ *  	time in branch-free loops that compilers vectorise, into a selection
+ *  	that the aggregation then walks.
+ *
+ *  	Results accumulate over scan() calls, so several logs can be
+ *  	queried in turn, or split between queries (e.g. one per core) whose
+ *  	results are combined with merge().
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_QUERY__
+#define __MS_5803_QUERY__
+
+#include <Arduino.h>
+#include "MS5803_Arrow.h"
+#include "MS5803_Transfer.h"
+
+// Aggregates of one sensor over one time bucket
+struct MS_5803_QueryGroup {
+    uint8_t sensor;
+    uint32_t bucket;         // ms / bucketMs of the readings
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+    float mean() const              {return count ? (float)sum / count : NAN;}
+};
+
+class MS_5803_Query {
+public:
+    // Reads batches of up to 'maxRows' rows (the writer's batchRows, at
+    // most 16383) and keeps up to 'groups' groups. Needs 14 bytes of RAM
+    // per row and 24 per group.
+    MS_5803_Query(uint16_t maxRows = 256, uint16_t groups = 64);
+    ~MS_5803_Query();
+    MS_5803_Query(const MS_5803_Query &) = delete;
+    MS_5803_Query &operator=(const MS_5803_Query &) = delete;
+    // Ranges a reading must be within, inclusive. All readings pass until
+    // they are set.
+    void whereTime(uint32_t fromMs, uint32_t toMs);
+    void wherePressure(int32_t min, int32_t max);
+    void whereTemperature(int32_t min, int32_t max);
+    // A bit per sensor number; 31 and up share bit 31
+    void whereSensors(uint32_t sensors);
+    // Group by sensor and by 'bucketMs' of time (0 for a single bucket),
+    // aggregating MS5803_ARROW_PRESSURE or MS5803_ARROW_TEMPERATURE
+    void groupBy(uint32_t bucketMs, uint8_t column = MS5803_ARROW_PRESSURE);
+    // Skip batches by their statistics (the default), or read them all,
+    // for comparison
+    void setSkipping(boolean skip)  {skipping = skip;}
+    // Forget the results and counts
+    void clear();
+    // Run the query over the batches listed in 'index' of the Arrow stream
+    // 'log'. Returns false if a batch couldn't be read or had more than
+    // maxRows rows (it is left out), or the groups ran out (the readings
+    // that didn't fit are left out).
+    boolean scan(MS_5803_BlockSource &log, MS_5803_BlockSource &index);
+    // Add the results of a query with the same grouping. Returns false if
+    // the groups ran out.
+    boolean merge(const MS_5803_Query &other);
+
+    // Groups, in the order they were first seen
+    uint16_t groups() const         {return used;}
+    const MS_5803_QueryGroup &group(uint16_t i) const {return results[i];}
+    // Batches read and skipped, and readings that matched
+    uint32_t blocksRead() const     {return _blocksRead;}
+    uint32_t blocksSkipped() const  {return _blocksSkipped;}
+    uint32_t matched() const        {return _matched;}
+
+private:
+    uint16_t capacity;
+    uint16_t maxGroups;
+    // Columns of the batch being scanned, and the selection
+    uint32_t *ms;
+    uint8_t *sensors;
+    int32_t *pressures;
+    int32_t *temperatures;
+    uint8_t *keep;
+    MS_5803_QueryGroup *results;
+    uint16_t used;
+    uint16_t last;
+    boolean full;
+    // The query
+    uint32_t fromMs, toMs;
+    int32_t pressureMin, pressureMax;
+    int32_t temperatureMin, temperatureMax;
+    uint32_t sensorMask;
+    uint32_t bucketMs;
+    uint8_t column;
+    boolean skipping;
+    uint32_t _blocksRead;
+    uint32_t _blocksSkipped;
+    uint32_t _matched;
+
+    // True if no reading of the batch can match
+    boolean excluded(const MS_5803_BlockStats &stats) const;
+    boolean scanBlock(MS_5803_BlockSource &log, const MS_5803_BlockStats &stats);
+    boolean readColumn(MS_5803_BlockSource &log, const MS_5803_BlockStats &stats,
+                       uint8_t column, void *data, uint8_t width);
+    // Group of a sensor and bucket, added if new; NULL if the groups ran out
+    MS_5803_QueryGroup *find(uint8_t sensor, uint32_t bucket);
+};
+
+#endif
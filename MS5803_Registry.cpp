@@ -0,0 +1,273 @@
+/*
+ *  MS5803_Registry
+ *  	Fleet registry of sensor coefficients. See MS5803_Registry.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Registry.h"
+#include "MS5803_Transfer.h"
+
+static const uint8_t registryMagic[4] = {'M', 'S', 'C', 'R'};
+#define REGISTRY_VERSION 1
+
+// Write a little-endian value of 'bytes' bytes, adding it to the CRC
+static boolean writeLE(Print &out, uint32_t value, uint8_t bytes, 
+                       uint16_t &crc) {
+    uint8_t data[4];
+    for (uint8_t i = 0; i < bytes; i++) {
+    	data[i] = value >> (8 * i);
+    }
+    crc = MS_5803_Transfer::crc16(data, bytes, crc);
+    return out.write(data, bytes) == bytes;
+}
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Registry::MS_5803_Registry(uint16_t capacity, uint8_t conversion) {
+    entries = new Entry[capacity];
+    _capacity = entries ? capacity : 0;
+    _count = 0;
+    _conversion = conversion == MS5803_CONVERT_FLOAT ? conversion 
+                                                     : MS5803_CONVERT_INTEGER;
+    for (uint8_t i = 0; i < MS5803_REGISTRY_CACHE; i++) {
+    	converters[i] = NULL;
+    }
+    invalidate();
+    _hits = 0;
+    _misses = 0;
+}
+
+MS_5803_Registry::~MS_5803_Registry() {
+    delete[] entries;
+    for (uint8_t i = 0; i < MS5803_REGISTRY_CACHE; i++) {
+    	delete converters[i];
+    }
+}
+
+//-------------------------------------------------
+uint32_t MS_5803_Registry::identity(const uint16_t prom[8]) {
+    uint8_t data[13];
+    for (uint8_t i = 1; i <= 6; i++) {
+    	data[2 * i - 2] = prom[i];
+    	data[2 * i - 1] = prom[i] >> 8;
+    }
+    // The CRC as initializeMS_5803() compares it
+    data[12] = prom[7];
+    uint32_t hash = 2166136261UL;
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+    	hash = (hash ^ data[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Registry::add(const uint16_t prom[8], uint32_t start, 
+                              uint32_t end) {
+    uint16_t copy[8];
+    memcpy(copy, prom, sizeof(copy));
+    if (MS_5803::MS_5803_CRC(copy) != (uint8_t)prom[7]) {
+    	return false;
+    }
+    uint32_t key = identity(prom);
+    // Insert after the entries that sort before or with it
+    uint16_t low = 0;
+    uint16_t high = _count;
+    while (low < high) {
+    	uint16_t mid = (low + high) / 2;
+    	if (entries[mid].id < key || 
+    			(entries[mid].id == key && entries[mid].start <= start)) {
+    		low = mid + 1;
+    	}
+    	else {
+    		high = mid;
+    	}
+    }
+    // An entry for the same sensor and start is replaced
+    if (low > 0 && entries[low - 1].id == key && 
+    		entries[low - 1].start == start) {
+    	low--;
+    }
+    else if (_count == _capacity) {
+    	return false;
+    }
+    else {
+    	memmove(entries + low + 1, entries + low, 
+    	        (_count - low) * sizeof(Entry));
+    	_count++;
+    }
+    entries[low].id = key;
+    entries[low].start = start;
+    entries[low].end = end;
+    memcpy(entries[low].prom, prom, sizeof(entries[low].prom));
+    invalidate();
+    return true;
+}
+
+//-------------------------------------------------
+void MS_5803_Registry::clear() {
+    _count = 0;
+    invalidate();
+}
+
+//-------------------------------------------------
+int16_t MS_5803_Registry::find(uint32_t key, uint32_t time) const {
+    // Last entry of the sensor starting at or before 'time'
+    uint16_t low = 0;
+    uint16_t high = _count;
+    while (low < high) {
+    	uint16_t mid = (low + high) / 2;
+    	if (entries[mid].id < key || 
+    			(entries[mid].id == key && entries[mid].start <= time)) {
+    		low = mid + 1;
+    	}
+    	else {
+    		high = mid;
+    	}
+    }
+    // If it has ended, an earlier, longer period may still cover 'time'
+    while (low > 0 && entries[low - 1].id == key) {
+    	low--;
+    	if (time < entries[low].end) {
+    		return low;
+    	}
+    }
+    return -1;
+}
+
+//-------------------------------------------------
+const uint16_t *MS_5803_Registry::coefficients(int16_t entry) const {
+    return entry >= 0 && entry < _count ? entries[entry].prom : NULL;
+}
+
+uint32_t MS_5803_Registry::id(int16_t entry) const {
+    return entry >= 0 && entry < _count ? entries[entry].id : 0;
+}
+
+uint32_t MS_5803_Registry::start(int16_t entry) const {
+    return entry >= 0 && entry < _count ? entries[entry].start : 0;
+}
+
+uint32_t MS_5803_Registry::end(int16_t entry) const {
+    return entry >= 0 && entry < _count ? entries[entry].end : 0;
+}
+
+//-------------------------------------------------
+MS_5803 *MS_5803_Registry::converter(uint32_t key, uint32_t time) {
+    int16_t entry = find(key, time);
+    if (entry < 0) {
+    	return NULL;
+    }
+    for (uint8_t i = 0; i < MS5803_REGISTRY_CACHE; i++) {
+    	if (cached[i] == entry) {
+    		_hits++;
+    		return converters[i];
+    	}
+    }
+    uint8_t slot = nextSlot;
+    if (!converters[slot]) {
+    	converters[slot] = new MS_5803();
+    	if (!converters[slot]) {
+    		return NULL;
+    	}
+    }
+    nextSlot = (nextSlot + 1) % MS5803_REGISTRY_CACHE;
+    MS_5803 *sensor = converters[slot];
+    memcpy(sensor->sensorCoeffs, entries[entry].prom, 
+           sizeof(sensor->sensorCoeffs));
+    sensor->prepareCoefficients();
+    sensor->setCalibration(0, 0);
+    sensor->setConversion(_conversion);
+    cached[slot] = entry;
+    _misses++;
+    return sensor;
+}
+
+//-------------------------------------------------
+void MS_5803_Registry::invalidate() {
+    for (uint8_t i = 0; i < MS5803_REGISTRY_CACHE; i++) {
+    	cached[i] = -1;
+    }
+    nextSlot = 0;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Registry::save(Print &out) const {
+    uint16_t crc = MS_5803_Transfer::crc16(registryMagic, 4);
+    boolean ok = out.write(registryMagic, 4) == 4;
+    ok &= writeLE(out, REGISTRY_VERSION, 1, crc);
+    ok &= writeLE(out, _count, 2, crc);
+    for (uint16_t i = 0; i < _count; i++) {
+    	ok &= writeLE(out, entries[i].start, 4, crc);
+    	ok &= writeLE(out, entries[i].end, 4, crc);
+    	for (uint8_t j = 0; j < 8; j++) {
+    		ok &= writeLE(out, entries[i].prom[j], 2, crc);
+    	}
+    }
+    uint16_t unused = 0;
+    ok &= writeLE(out, crc, 2, unused);
+    return ok;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Registry::load(Stream &in) {
+    clear();
+    uint16_t crc = 0xFFFF;
+    uint32_t value;
+    for (uint8_t i = 0; i < 4; i++) {
+    	if (!readLE(in, value, 1, crc) || value != registryMagic[i]) {
+    		return false;
+    	}
+    }
+    uint32_t count;
+    if (!readLE(in, value, 1, crc) || value != REGISTRY_VERSION ||
+    		!readLE(in, count, 2, crc) || count > _capacity) {
+    	return false;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+    	uint32_t start;
+    	uint32_t end;
+    	uint16_t prom[8];
+    	if (!readLE(in, start, 4, crc) || !readLE(in, end, 4, crc)) {
+    		clear();
+    		return false;
+    	}
+    	for (uint8_t j = 0; j < 8; j++) {
+    		if (!readLE(in, value, 2, crc)) {
+    			clear();
+    			return false;
+    		}
+    		prom[j] = value;
+    	}
+    	if (!add(prom, start, end)) {
+    		clear();
+    		return false;
+    	}
+    }
+    uint16_t expected = crc;
+    if (!readLE(in, value, 2, crc) || value != expected) {
+    	clear();
+    	return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Registry::readLE(Stream &in, uint32_t &value, uint8_t bytes,
+                                 uint16_t &crc) {
+    value = 0;
+    for (uint8_t i = 0; i < bytes; i++) {
+    	int c = in.read();
+    	if (c < 0) {
+    		return false;
+    	}
+    	uint8_t b = c;
+    	crc = MS_5803_Transfer::crc16(&b, 1, crc);
+    	value |= (uint32_t)b << (8 * i);
+    }
+    return true;
+}
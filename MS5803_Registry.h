@@ -0,0 +1,112 @@
+/*
+ *  MS5803_Registry
+ *  	Registry of the PROM coefficients of a fleet of sensors, for 
+ *  	converting archived raw readings (D1, D2) of many sensors with the
+ *  	right coefficients. A sensor is identified by a hash of its C1-C6
+ *  	and CRC, see identity(), so the identity can be recorded with its 
+ *  	logs without a separate serial number.
+ *
+ *  	Each entry holds a PROM dump and the period it is valid for (e.g. 
+ *  	between a sensor's installation and its replacement), in seconds on
+ *  	any clock the logs use (e.g. Unix time). Entries are kept sorted by 
+ *  	identity and start, so find() is a binary search, O(log n). Where 
+ *  	the periods of a sensor overlap, the entry that started last wins.
+ *
+ *  	converter() returns an MS_5803 with the coefficients of an entry 
+ *  	already prepared, for convertRaw(). The last few are cached, so 
+ *  	converting a log of one sensor prepares them once.
+ *
+ *  	save() writes the registry compactly to any Print (a file on an SD
+ *  	card or a host file wrapper...) and load() reads it back from a 
+ *  	Stream: "MSCR", version (1 byte), entry count (uint16_t), then per
+ *  	entry the start and end (uint32_t) and the 8 PROM words (uint16_t), 
+ *  	then a CRC-16/CCITT of everything before it, all little-endian. The
+ *  	identities are not stored but computed again from the PROM.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_REGISTRY__
+#define __MS_5803_REGISTRY__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+#define MS5803_REGISTRY_FOREVER	0xFFFFFFFF // End of a period still open
+#define MS5803_REGISTRY_ENTRY	24	// Bytes per entry in save()
+#define MS5803_REGISTRY_CACHE	4	// Converters kept by converter()
+
+class MS_5803_Registry {
+public:
+    // Room for 'capacity' entries (28 bytes each). converter() sets up its
+    // converters with 'conversion', MS5803_CONVERT_INTEGER or _FLOAT.
+    MS_5803_Registry(uint16_t capacity = 64, 
+                     uint8_t conversion = MS5803_CONVERT_INTEGER);
+    ~MS_5803_Registry();
+    MS_5803_Registry(const MS_5803_Registry &) = delete;
+    MS_5803_Registry &operator=(const MS_5803_Registry &) = delete;
+    // Identity of a sensor: FNV-1a hash of C1-C6 and the CRC of its PROM
+    static uint32_t identity(const uint16_t prom[8]);
+    // Add the PROM of a sensor, valid from 'start' until before 'end'. 
+    // Returns false if the registry is full or the PROM fails its CRC.
+    boolean add(const uint16_t prom[8], uint32_t start, 
+                uint32_t end = MS5803_REGISTRY_FOREVER);
+    boolean add(const MS_5803 &sensor, uint32_t start, 
+                uint32_t end = MS5803_REGISTRY_FOREVER) {
+        return add(sensor.sensorCoeffs, start, end);
+    }
+    void clear();
+    // Entry for sensor 'id' at 'time', or -1 if there is none
+    int16_t find(uint32_t id, uint32_t time) const;
+    // PROM of an entry (8 words), or NULL for an invalid entry
+    const uint16_t *coefficients(int16_t entry) const;
+    // Identity and validity period of an entry
+    uint32_t id(int16_t entry) const;
+    uint32_t start(int16_t entry) const;
+    uint32_t end(int16_t entry) const;
+    // A converter for the readings of sensor 'id' at 'time', or NULL if 
+    // the registry has no coefficients for them. It stays valid until the 
+    // next call (which may reuse it) or a change to the registry.
+    MS_5803 *converter(uint32_t id, uint32_t time);
+    // Write the registry, returning false if the output took less
+    boolean save(Print &out) const;
+    // Replace the registry with one written by save(). Returns false, 
+    // leaving it empty, if it is damaged or doesn't fit.
+    boolean load(Stream &in);
+    
+    uint16_t count() const          {return _count;}
+    uint16_t capacity() const       {return _capacity;}
+    // converter() calls answered from the cache, and that prepared one
+    uint32_t hits() const           {return _hits;}
+    uint32_t misses() const         {return _misses;}
+
+private:
+    struct Entry {
+    	uint32_t id;
+    	uint32_t start;
+    	uint32_t end;
+    	uint16_t prom[8];
+    };
+    Entry *entries;
+    uint16_t _capacity;
+    uint16_t _count;
+    uint8_t _conversion;
+    // Cached converters, the entry each was prepared for (-1 for none),
+    // and the next one to reuse
+    MS_5803 *converters[MS5803_REGISTRY_CACHE];
+    int16_t cached[MS5803_REGISTRY_CACHE];
+    uint8_t nextSlot;
+    uint32_t _hits;
+    uint32_t _misses;
+    
+    void invalidate();
+    // Read a little-endian value of 'bytes' bytes, adding it to the CRC
+    boolean readLE(Stream &in, uint32_t &value, uint8_t bytes, 
+                   uint16_t &crc);
+};
+
+#endif
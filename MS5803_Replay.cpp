@@ -0,0 +1,162 @@
+/*
+ *  MS5803_Replay
+ *  	Simulated MS5803 fed by recorded traces. See MS5803_Replay.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Replay.h"
+
+// Longest CSV line accepted
+#define REPLAY_LINE 64
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Replay::MS_5803_Replay(Stream &trace, uint8_t format) {
+    _trace = &trace;
+    _format = format;
+    memset(_prom, 0, sizeof(_prom));
+    hasPROM = false;
+    _finished = false;
+    _timestamp = 0;
+    d1 = 0;
+    d2 = 0;
+    pending = false;
+    nextTimestamp = 0;
+    nextD1 = 0;
+    nextD2 = 0;
+    hasNext = false;
+    records = 0;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Replay::begin() {
+    if (_format == MS5803_REPLAY_BINARY) {
+    	uint32_t word;
+    	hasPROM = true;
+    	for (uint8_t i = 0; i < 8; i++) {
+    		if (!readLE(word, 2)) {
+    			hasPROM = false;
+    			break;
+    		}
+    		_prom[i] = word;
+    	}
+    }
+    // For CSV the PROM line, if any, is read along with the first record
+    hasNext = nextRecord();
+    _finished = !hasNext;
+    return hasPROM;
+}
+
+//-------------------------------------------------
+void MS_5803_Replay::setPROM(const uint16_t coeffs[8]) {
+    memcpy(_prom, coeffs, sizeof(_prom));
+    hasPROM = true;
+}
+
+//-------------------------------------------------
+uint16_t MS_5803_Replay::prom(uint8_t index) {
+    return index < 8 ? _prom[index] : 0;
+}
+
+//-------------------------------------------------
+uint32_t MS_5803_Replay::convert(char command) {
+    // A reading is a D1 conversion then a D2 conversion. The record is 
+    // moved on at the D1 after a D2 has used it, and the one after it is
+    // read ahead.
+    if (!isTemperature(command)) {
+    	if (!pending && hasNext) {
+    		_timestamp = nextTimestamp;
+    		d1 = nextD1;
+    		d2 = nextD2;
+    		pending = true;
+    		hasNext = nextRecord();
+    	}
+    	return d1;
+    }
+    if (pending) {
+    	pending = false;
+    	records++;
+    	_finished = !hasNext;
+    }
+    return d2;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Replay::nextRecord() {
+    return _format == MS5803_REPLAY_BINARY ? nextBinary() : nextCSV();
+}
+
+//-------------------------------------------------
+boolean MS_5803_Replay::nextCSV() {
+    char line[REPLAY_LINE];
+    int length;
+    while ((length = readLine(line, sizeof(line))) >= 0) {
+    	if (length == 0 || line[0] == '#') {
+    		continue;
+    	}
+    	char *p = line;
+    	if (strncmp(line, "prom,", 5) == 0) {
+    		p += 5;
+    		for (uint8_t i = 0; i < 8; i++) {
+    			_prom[i] = strtoul(p, &p, 10);
+    			if (*p == ',') {
+    				p++;
+    			}
+    		}
+    		hasPROM = true;
+    		continue;
+    	}
+    	nextTimestamp = strtoul(p, &p, 10);
+    	if (*p++ != ',') {
+    		continue;
+    	}
+    	nextD1 = strtoul(p, &p, 10);
+    	if (*p++ != ',') {
+    		continue;
+    	}
+    	nextD2 = strtoul(p, &p, 10);
+    	return true;
+    }
+    return false;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Replay::nextBinary() {
+    return readLE(nextTimestamp, 4) && readLE(nextD1, 4) && readLE(nextD2, 4);
+}
+
+//-------------------------------------------------
+int MS_5803_Replay::readLine(char *line, uint8_t size) {
+    uint8_t length = 0;
+    int c = _trace->read();
+    if (c < 0) {
+    	return -1;
+    }
+    while (c >= 0 && c != '\n') {
+    	// Drop carriage returns and anything past the buffer
+    	if (c != '\r' && length < size - 1) {
+    		line[length++] = c;
+    	}
+    	c = _trace->read();
+    }
+    line[length] = '\0';
+    return length;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Replay::readLE(uint32_t &value, uint8_t bytes) {
+    value = 0;
+    for (uint8_t i = 0; i < bytes; i++) {
+    	int c = _trace->read();
+    	if (c < 0) {
+    		return false;
+    	}
+    	value |= (uint32_t)c << (8 * i);
+    }
+    return true;
+}
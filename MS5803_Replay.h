@@ -0,0 +1,81 @@
+/*
+ *  MS5803_Replay
+ *  	Simulated MS5803 that replays recorded D1/D2 traces, so filters and
+ *  	detectors can be run on real-world data faster than real time. The 
+ *  	trace is read from any Stream (a file on an SD card or a host file
+ *  	wrapper, a serial port...) as either
+ *
+ *  	CSV:    one reading per line, "ms,D1,D2", and optionally a line
+ *  	        "prom,C0,C1,C2,C3,C4,C5,C6,C7" with the recorded PROM before
+ *  	        the readings. Lines starting with '#' are ignored.
+ *  	Binary: the 8 PROM words (uint16_t), then 12-byte records of ms, D1 
+ *  	        and D2 (uint32_t), all little-endian.
+ *
+ *  	Each reading (a D1 then a D2 conversion) uses the next record, and 
+ *  	timestamp() gives the time it was originally taken at, so consumers
+ *  	can keep the original timing without waiting for it.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_REPLAY__
+#define __MS_5803_REPLAY__
+
+#include <Arduino.h>
+#include "MS5803_Sim.h"
+
+#define MS5803_REPLAY_CSV		0
+#define MS5803_REPLAY_BINARY	1
+
+class MS_5803_Replay : public MS_5803_SimDevice {
+public:
+    MS_5803_Replay(Stream &trace, uint8_t format = MS5803_REPLAY_CSV);
+    // Load the recorded PROM (and the first record). Call before 
+    // MS_5803::initializeMS_5803(). Returns false if the trace had no PROM.
+    boolean begin();
+    // Use this PROM instead of, or in the absence of, a recorded one
+    void setPROM(const uint16_t coeffs[8]);
+    // Time the current record was taken at, in ms
+    uint32_t timestamp() const      {return _timestamp;}
+    // True once the reading that used the last record has been taken, so
+    // that 'while (!replay.finished())' takes one reading per record. 
+    // Further readings repeat the last record.
+    boolean finished() const        {return _finished;}
+    // Number of records replayed
+    uint32_t count() const          {return records;}
+
+    uint16_t prom(uint8_t index);
+    uint32_t convert(char command);
+
+private:
+    Stream *_trace;
+    uint8_t _format;
+    uint16_t _prom[8];
+    boolean hasPROM;
+    boolean _finished;
+    // Current record, and whether it has been used by a D2 conversion yet
+    uint32_t _timestamp;
+    uint32_t d1;
+    uint32_t d2;
+    boolean pending;
+    // The record after it, read ahead to know when the trace runs out
+    uint32_t nextTimestamp;
+    uint32_t nextD1;
+    uint32_t nextD2;
+    boolean hasNext;
+    uint32_t records;
+    // Read the next record into nextTimestamp, nextD1 and nextD2
+    boolean nextRecord();
+    boolean nextCSV();
+    boolean nextBinary();
+    // Read one CSV line, without the line end. Returns its length or -1.
+    int readLine(char *line, uint8_t size);
+    // Read a little-endian value of 'bytes' bytes
+    boolean readLE(uint32_t &value, uint8_t bytes);
+};
+
+#endif
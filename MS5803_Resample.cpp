@@ -0,0 +1,172 @@
+/*
+ *  MS5803_Resample
+ *  	Resampling of irregular readings onto a regular grid. See 
+ *  	MS5803_Resample.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Resample.h"
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Resample::MS_5803_Resample(uint32_t intervalMs, uint32_t maxGapMs,
+                                   uint8_t method, uint32_t origin) {
+    _interval = intervalMs ? intervalMs : 1;
+    _maxGap = maxGapMs;
+    _method = method;
+    _origin = origin;
+    ranged = false;
+    from = 0;
+    to = 0;
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_Resample::reset() {
+    count = 0;
+    ready = false;
+    started = false;
+    cursor = 0;
+    _time = 0;
+    _value = MS5803_RESAMPLE_GAP;
+}
+
+//-------------------------------------------------
+void MS_5803_Resample::setRange(uint32_t fromMs, uint32_t toMs) {
+    ranged = true;
+    from = fromMs;
+    to = toMs;
+}
+
+//-------------------------------------------------
+void MS_5803_Resample::add(uint32_t ms, int32_t value) {
+    if (count > 0 && (int32_t)(ms - times[count - 1]) <= 0) {
+    	return;
+    }
+    if (count == 4) {
+    	for (uint8_t i = 0; i < 3; i++) {
+    		times[i] = times[i + 1];
+    		values[i] = values[i + 1];
+    	}
+    	count--;
+    }
+    times[count] = ms;
+    values[count] = value;
+    count++;
+    // Linear segments are complete as soon as they end; cubic ones need 
+    // the reading after for the slope at their end.
+    uint8_t needed = _method == MS5803_RESAMPLE_CUBIC ? 3 : 2;
+    if (count >= needed) {
+    	setSegment(count - needed, false);
+    }
+}
+
+//-------------------------------------------------
+void MS_5803_Resample::flush() {
+    if (count == 0) {
+    	return;
+    }
+    if (count == 1) {
+    	setSegment(0, true);
+    }
+    else {
+    	setSegment(count - 2, true);
+    }
+}
+
+//-------------------------------------------------
+void MS_5803_Resample::setSegment(uint8_t a, boolean endPoint) {
+    uint8_t b = a + 1 < count ? a + 1 : a;
+    hasBefore = a > 0;
+    hasAfter = b + 1 < count;
+    segTimes[0] = hasBefore ? times[a - 1] : times[a];
+    segValues[0] = hasBefore ? values[a - 1] : values[a];
+    segTimes[1] = times[a];
+    segValues[1] = values[a];
+    segTimes[2] = times[b];
+    segValues[2] = values[b];
+    segTimes[3] = hasAfter ? times[b + 1] : times[b];
+    segValues[3] = hasAfter ? values[b + 1] : values[b];
+    inclusive = endPoint;
+    ready = true;
+    // Move the cursor to the first grid point of the segment that hasn't
+    // been given yet. Working it out from the origin each time keeps the
+    // grid aligned to it when the times wrap around.
+    uint32_t start = segTimes[1];
+    if (started && (int32_t)(cursor - start) > 0) {
+    	start = cursor;
+    }
+    started = true;
+    uint32_t offset = (start - _origin) % _interval;
+    cursor = offset ? start + _interval - offset : start;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Resample::next() {
+    while (ready) {
+    	int32_t left = segTimes[2] - cursor;
+    	if (left < 0 || (left == 0 && !inclusive)) {
+    		ready = false;
+    		break;
+    	}
+    	uint32_t t = cursor;
+    	cursor += _interval;
+    	if (ranged && (int32_t)(t - to) >= 0) {
+    		ready = false;
+    		break;
+    	}
+    	if (ranged && (int32_t)(t - from) < 0) {
+    		continue;
+    	}
+    	_time = t;
+    	_value = interpolate(t);
+    	return true;
+    }
+    return false;
+}
+
+//-------------------------------------------------
+int32_t MS_5803_Resample::interpolate(uint32_t t) const {
+    uint32_t h = segTimes[2] - segTimes[1];
+    if (h > _maxGap) {
+    	return MS5803_RESAMPLE_GAP;
+    }
+    if (h == 0) {
+    	return segValues[1];
+    }
+    uint32_t dt = t - segTimes[1];
+    int32_t rise = segValues[2] - segValues[1];
+    if (_method == MS5803_RESAMPLE_CUBIC) {
+    	// Cubic Hermite, relative to the first reading
+    	float s = (float)dt / h;
+    	float s2 = s * s;
+    	float s3 = s2 * s;
+    	float y = (3 * s2 - 2 * s3) * rise 
+    			+ ((s3 - 2 * s2 + s) * slope(1) + (s3 - s2) * slope(2)) * h;
+    	return segValues[1] + (int32_t)lround(y);
+    }
+    int64_t y = (int64_t)rise * dt;
+    y += y >= 0 ? h / 2 : -(int64_t)(h / 2);
+    return segValues[1] + (int32_t)(y / (int64_t)h);
+}
+
+//-------------------------------------------------
+// Average of the slopes of the segment and its neighbour on that side, or
+// the segment's own if there is no neighbour or it is a gap
+float MS_5803_Resample::slope(uint8_t i) const {
+    uint32_t h = segTimes[2] - segTimes[1];
+    float own = (float)(segValues[2] - segValues[1]) / h;
+    boolean side = i == 1 ? hasBefore : hasAfter;
+    uint8_t near = i == 1 ? 0 : 2;
+    uint32_t span = segTimes[near + 1] - segTimes[near];
+    if (!side || span > _maxGap || span == 0) {
+    	return own;
+    }
+    float other = (float)(segValues[near + 1] - segValues[near]) / span;
+    return (own + other) / 2;
+}
@@ -0,0 +1,94 @@
+/*
+ *  MS5803_Resample
+ *  	Streaming resampler from readings at irregular times (sleep 
+ *  	schedules, retries) onto a regular grid, for analyses that need 
+ *  	uniform samples (FFT, tides, comparing sensors). Grid points between
+ *  	readings further apart than a maximum gap are marked as gaps rather 
+ *  	than bridged. Interpolation is linear, or cubic (Hermite, with slopes
+ *  	from the neighbouring readings, one reading later).
+ *
+ *  	To process an archive in parallel chunks, give each chunk's 
+ *  	resampler the chunk's time range with setRange() and feed it the 
+ *  	chunk's readings plus two readings either side. The chunks then give
+ *  	exactly the grid points a single pass would, each once.
+ *
+ *  	Times are in ms and may wrap around (the grid stays aligned to its 
+ *  	origin, so the interval across the wrap is shorter). Readings must be
+ *  	in time order.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_RESAMPLE__
+#define __MS_5803_RESAMPLE__
+
+#include <Arduino.h>
+
+#define MS5803_RESAMPLE_LINEAR 0
+#define MS5803_RESAMPLE_CUBIC  1
+// Value of a grid point in a gap
+#define MS5803_RESAMPLE_GAP ((int32_t)0x80000000)
+
+class MS_5803_Resample {
+public:
+    // Grid points are at 'origin' + k * 'intervalMs'. Readings more than 
+    // 'maxGapMs' apart have a gap between them.
+    MS_5803_Resample(uint32_t intervalMs, uint32_t maxGapMs, 
+                     uint8_t method = MS5803_RESAMPLE_LINEAR, 
+                     uint32_t origin = 0);
+    // Forget all readings
+    void reset();
+    // Only give grid points from 'fromMs' up to (not including) 'toMs'
+    void setRange(uint32_t fromMs, uint32_t toMs);
+    // Add a reading (e.g. pressureInt()) taken at 'ms'. Readings at or 
+    // before the last one are ignored. Read the grid points it completes
+    // with next() before adding another reading; any left are skipped.
+    void add(uint32_t ms, int32_t value);
+    // Complete the grid points up to the last reading
+    void flush();
+    // Move to the next completed grid point. Returns false when there are
+    // no more for now.
+    boolean next();
+    // Time and value of the current grid point. The value is 
+    // MS5803_RESAMPLE_GAP in a gap.
+    uint32_t time() const           {return _time;}
+    int32_t value() const           {return _value;}
+    boolean gap() const             {return _value == MS5803_RESAMPLE_GAP;}
+
+private:
+    uint32_t _interval;
+    uint32_t _maxGap;
+    uint8_t _method;
+    uint32_t _origin;
+    boolean ranged;
+    uint32_t from;
+    uint32_t to;
+    // Last four readings, newest last
+    uint32_t times[4];
+    int32_t values[4];
+    uint8_t count;
+    // Segment ready for next(): readings a to b, with the readings either 
+    // side for the cubic slopes
+    uint32_t segTimes[4];
+    int32_t segValues[4];
+    boolean hasBefore;
+    boolean hasAfter;
+    boolean inclusive;
+    boolean ready;
+    boolean started;
+    uint32_t cursor;
+    uint32_t _time;
+    int32_t _value;
+    
+    // Make readings a and a + 1 (of times[]) the segment for next()
+    void setSegment(uint8_t a, boolean endPoint);
+    int32_t interpolate(uint32_t t) const;
+    // Slope (per ms) at reading 1 or 2 of the segment
+    float slope(uint8_t i) const;
+};
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ *  MS5803_SignalGen
+ *  	Physics-based signal generator for a simulated MS5803. See 
+ *  	MS5803_SignalGen.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_SignalGen.h"
+
+// Example PROM from the MS5803 data sheet
+static const uint16_t defaultPROM[8] = {0, 46372, 43981, 29059, 27842, 31553, 28165, 0};
+// Approximate RMS temperature noise (C) of the MS5803-05BA at each OSR
+// (256..4096), from the resolution table of the data sheet
+static const float temperatureNoise[5] = {0.012, 0.008, 0.005, 0.003, 0.002};
+// Pressure of 1 m of sea water in mbar, and g in m/s^2
+#define MBAR_PER_M 100.5
+#define GRAVITY 9.81
+// Tide periods in s
+#define M2_PERIOD 44714.16
+#define S2_PERIOD 43200.0
+
+//-------------------------------------------------
+// Constructor
+MS_5803_SignalGen::MS_5803_SignalGen(const MS_5803_SignalConfig &config,
+                                     const uint16_t *coeffs) {
+    cfg = config;
+    if (cfg.intervalMs == 0) {
+    	cfg.intervalMs = 1;
+    }
+    memcpy(_prom, coeffs ? coeffs : defaultPROM, sizeof(_prom));
+    _prom[7] = 0;
+    _prom[7] = MS_5803::MS_5803_CRC(_prom);
+    t = 0;
+    rng = cfg.seed ? cfg.seed : 1;
+    setStep(stepM2, M2_PERIOD, cfg.intervalMs);
+    setStep(stepS2, S2_PERIOD, cfg.intervalMs);
+    setStep(stepWave, cfg.wavePeriod, cfg.intervalMs);
+    setStep(stepDaily, 86400.0, cfg.intervalMs);
+    tideM2[0] = tideS2[0] = wave[0] = daily[0] = 1;
+    tideM2[1] = tideS2[1] = wave[1] = daily[1] = 0;
+    renormalise = 0;
+    // Deep water waves: k = w^2 / g, pressure amplitude falls as e^(-k d)
+    waveScale = 0;
+    if (cfg.wavePeriod > 0 && cfg.depth > 0) {
+    	float w = 2 * PI / cfg.wavePeriod;
+    	waveScale = cfg.waveHeight * exp(-w * w / GRAVITY * cfg.depth);
+    }
+    lagAlpha = cfg.thermalLag > 0 
+    		? 1 - exp(-(cfg.intervalMs / 1000.0) / cfg.thermalLag) : 1;
+    frontFrom = 0;
+    frontTo = 0;
+    frontStep = 0;
+    // No fronts if frontHours is 0
+    frontSteps = 0;
+    if (cfg.frontHours > 0) {
+    	frontSteps = max((uint32_t)1, (uint32_t)(cfg.frontHours * 3600000.0 / cfg.intervalMs));
+    }
+    sensorTemp = cfg.temperature;
+    for (uint8_t i = 0; i < 8; i++) {
+    	pinkRows[i] = 0;
+    }
+    pinkSum = 0;
+    sample = 0;
+    _truePressure = cfg.pressure;
+    _trueTemp = cfg.temperature;
+    d1 = 0;
+    d2 = 0;
+    haveReading = false;
+}
+
+//-------------------------------------------------
+uint16_t MS_5803_SignalGen::prom(uint8_t index) {
+    return index < 8 ? _prom[index] : 0;
+}
+
+//-------------------------------------------------
+uint32_t MS_5803_SignalGen::convert(char command) {
+    // A reading is a D1 conversion then a D2 conversion; both come from the
+    // same instant, and time moves on after the D2.
+    if (!isTemperature(command)) {
+    	if (haveReading) {
+    		advance();
+    	}
+    	makeReading(min((command & 0x0F) >> 1, 4));
+    	haveReading = true;
+    	return d1;
+    }
+    return d2;
+}
+
+//-------------------------------------------------
+// Moves the true signal on by one interval
+void MS_5803_SignalGen::advance() {
+    t += cfg.intervalMs;
+    rotate(tideM2, stepM2);
+    rotate(tideS2, stepS2);
+    rotate(wave, stepWave);
+    rotate(daily, stepDaily);
+    // Keep the phasors on the unit circle despite rounding
+    if (++renormalise >= 4096) {
+    	renormalise = 0;
+    	double *p[4] = {tideM2, tideS2, wave, daily};
+    	for (uint8_t i = 0; i < 4; i++) {
+    		double r = sqrt(p[i][0] * p[i][0] + p[i][1] * p[i][1]);
+    		p[i][0] /= r;
+    		p[i][1] /= r;
+    	}
+    }
+    if (frontSteps && ++frontStep >= frontSteps) {
+    	frontStep = 0;
+    	frontFrom = frontTo;
+    	frontTo = cfg.frontAmplitude * (2 * uniform() - 1);
+    }
+}
+
+//-------------------------------------------------
+// Computes the true and measured signal at the current time and inverts
+// the compensation to get D1 and D2.
+void MS_5803_SignalGen::makeReading(uint8_t osr) {
+    float ambient = cfg.temperature + cfg.dailyTemperature * daily[1]
+    		+ cfg.temperatureRamp * (t / 3600000.0);
+    sensorTemp += (ambient - sensorTemp) * lagAlpha;
+    float p;
+    if (cfg.sealed) {
+    	// Gas law: the pressure of the remaining gas scales with the
+    	// absolute temperature
+    	p = (cfg.pressure - cfg.leakRate * (t / 3600000.0)) 
+    			* (sensorTemp + 273.15) / (cfg.temperature + 273.15);
+    }
+    else {
+    	p = cfg.pressure;
+    	if (frontSteps) {
+    		p += frontFrom + (frontTo - frontFrom) * frontStep / frontSteps;
+    	}
+    	if (cfg.depth > 0) {
+    		float head = cfg.depth + cfg.tideM2 * tideM2[1] 
+    				+ cfg.tideS2 * tideS2[1] + waveScale * wave[1];
+    		p += MBAR_PER_M * max(head, (float)0);
+    	}
+    }
+    _truePressure = p;
+    _trueTemp = sensorTemp;
+    
+    // White noise at the OSR's resolution plus 1/f noise. The 1/f part uses
+    // the Voss-McCartney method: row i is redrawn every 2^i samples.
+    sample++;
+    uint8_t row = 0;
+    while (row < 7 && !(sample & (1UL << row))) {
+    	row++;
+    }
+    float draw = gaussian();
+    pinkSum += draw - pinkRows[row];
+    pinkRows[row] = draw;
+    float noise = gaussian() + cfg.pinkNoise * pinkSum / sqrt(8.0);
+    p += MS_5803::pressureNoise(256U << osr) * noise;
+    float temp = sensorTemp + temperatureNoise[osr] * gaussian();
+    if (cfg.spikeRate > 0 && uniform() < cfg.spikeRate) {
+    	p += cfg.spikeSize;
+    }
+    
+    // Invert the compensation. First dT from the temperature, allowing for
+    // the 2nd order term below 20C, which depends on dT itself.
+    double c6 = _prom[6] ? _prom[6] : 1;
+    double target = temp * 100;
+    double dT = (target - 2000) * 8388608.0 / c6;
+    if (target < 2000) {
+    	for (uint8_t i = 0; i < 3; i++) {
+    		dT = (target + 3 * dT * dT / 8589934592.0 - 2000) * 8388608.0 / c6;
+    	}
+    }
+    double temp1 = 2000 + dT * c6 / 8388608.0;
+    double off = _prom[2] * 262144.0 + _prom[4] * dT / 32;
+    double sens = _prom[1] * 131072.0 + _prom[3] * dT / 128;
+    if (temp1 < 2000) {
+    	off -= 3 * (temp1 - 2000) * (temp1 - 2000) / 8;
+    	sens -= 7 * (temp1 - 2000) * (temp1 - 2000) / 8;
+    }
+    // Then D1 from P = (D1 * SENS / 2^21 - OFF) / 2^15
+    double raw1 = (p * 100 * 32768.0 + off) * 2097152.0 / sens;
+    double raw2 = dT + _prom[5] * 256.0;
+    d1 = (uint32_t)constrain(raw1 + 0.5, 0.0, 16777215.0);
+    d2 = (uint32_t)constrain(raw2 + 0.5, 0.0, 16777215.0);
+    if (cfg.dropoutRate > 0 && uniform() < cfg.dropoutRate) {
+    	d1 = 0;
+    }
+}
+
+//-------------------------------------------------
+void MS_5803_SignalGen::rotate(double *phasor, const double *step) {
+    double c = phasor[0] * step[0] - phasor[1] * step[1];
+    double s = phasor[1] * step[0] + phasor[0] * step[1];
+    phasor[0] = c;
+    phasor[1] = s;
+}
+
+//-------------------------------------------------
+// Rotation by one interval of a sinusoid with the given period
+void MS_5803_SignalGen::setStep(double *step, double periodSeconds,
+                                uint32_t ms) {
+    if (periodSeconds <= 0) {
+    	step[0] = 1;
+    	step[1] = 0;
+    	return;
+    }
+    double angle = 2 * PI * (ms / 1000.0) / periodSeconds;
+    step[0] = cos(angle);
+    step[1] = sin(angle);
+}
+
+//-------------------------------------------------
+// Uniform in [0, 1) from a xorshift generator
+float MS_5803_SignalGen::uniform() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng >> 8) * (1.0 / 16777216.0);
+}
+
+//-------------------------------------------------
+// Approximately normal with unit variance: the sum of 4 uniforms has
+// variance 1/3.
+float MS_5803_SignalGen::gaussian() {
+    return (uniform() + uniform() + uniform() + uniform() - 2) * 1.7320508;
+}
@@ -0,0 +1,114 @@
+/*
+ *  MS5803_SignalGen
+ *  	Simulated MS5803 that generates long, realistic synthetic datasets:
+ *  	- barometric weather fronts (ramps to a new random level every few 
+ *  	  days)
+ *  	- M2 and S2 tides, and surface waves attenuated with depth, when the
+ *  	  sensor is under water
+ *  	- or a sealed housing whose pressure follows the temperature (gas 
+ *  	  law) and falls through a leak
+ *  	- daily temperature cycles and ramps, seen through the thermal lag 
+ *  	  of the sensor
+ *  	- white and 1/f noise scaled to the resolution of each OSR
+ *  	- rare spikes and dropouts (a D1 of 0, as from a read too early)
+ *  	The pressure and temperature are turned into D1 and D2 by inverting 
+ *  	the compensation for the simulated sensor's PROM, so every layer of 
+ *  	the driver from MS_5803_ADC() upward is exercised. 
+ *
+ *  	Each reading costs a few dozen floating point operations (no trig or 
+ *  	log calls), so 10^9 samples take minutes on a host.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_SIGNALGEN__
+#define __MS_5803_SIGNALGEN__
+
+#include <Arduino.h>
+#include "MS5803_Sim.h"
+
+// Settings of the generated signal. Set any of them to 0 to leave that 
+// component out.
+struct MS_5803_SignalConfig {
+    uint32_t intervalMs = 1000;    // time between readings
+    float pressure = 1013.25;      // mean atmospheric pressure (or at
+                                   // the start in a sealed housing), mbar
+    float frontAmplitude = 15;     // largest change from the mean, mbar
+    float frontHours = 72;         // time between fronts (0 for none)
+    float depth = 0;               // sensor depth below mean water level, m
+    boolean sealed = false;        // in a sealed housing instead: the 
+                                   // pressure follows the temperature
+    float leakRate = 0;            // pressure lost by a sealed housing at
+                                   // the mean temperature, mbar per hour
+    float tideM2 = 0.5;            // M2 tide amplitude, m (only under water)
+    float tideS2 = 0.2;            // S2 tide amplitude, m
+    float waveHeight = 0.3;        // surface wave amplitude, m
+    float wavePeriod = 8;          // surface wave period, s
+    float temperature = 15;        // mean temperature, C
+    float dailyTemperature = 4;    // amplitude of the daily cycle, C
+    float temperatureRamp = 0;     // steady change, C per hour
+    float thermalLag = 600;        // time constant of the sensor, s
+    float pinkNoise = 0.5;         // 1/f noise RMS relative to white noise
+    float spikeRate = 1e-6;        // probability of a spike per reading
+    float spikeSize = 50;          // spike height, mbar
+    float dropoutRate = 1e-6;      // probability of a dropout per reading
+    uint32_t seed = 1;             // random seed
+};
+
+class MS_5803_SignalGen : public MS_5803_SimDevice {
+public:
+    // Uses the example PROM from the MS5803 data sheet unless coefficients
+    // are given (words 1-6; the CRC is filled in).
+    MS_5803_SignalGen(const MS_5803_SignalConfig &config,
+                      const uint16_t *coeffs = NULL);
+    // Time of the current reading, ms since the start
+    uint64_t time() const           {return t;}
+    // True pressure (mbar) and temperature (C) of the current reading,
+    // before noise, spikes and dropouts
+    float truePressure() const      {return _truePressure;}
+    float trueTemperature() const   {return _trueTemp;}
+    
+    uint16_t prom(uint8_t index);
+    uint32_t convert(char command);
+
+private:
+    MS_5803_SignalConfig cfg;
+    uint16_t _prom[8];
+    uint64_t t;
+    uint32_t rng;
+    // Rotating phasors for the M2 and S2 tides, waves and the daily cycle
+    double tideM2[2], tideS2[2], wave[2], daily[2];
+    double stepM2[2], stepS2[2], stepWave[2], stepDaily[2];
+    uint32_t renormalise;
+    float waveScale;
+    float lagAlpha;
+    // Weather front: level at the start of the current front and target
+    float frontFrom;
+    float frontTo;
+    uint32_t frontStep;
+    uint32_t frontSteps;
+    float sensorTemp;
+    // Voss-McCartney rows of the 1/f noise
+    float pinkRows[8];
+    float pinkSum;
+    uint32_t sample;
+    // Current reading
+    float _truePressure;
+    float _trueTemp;
+    uint32_t d1;
+    uint32_t d2;
+    boolean haveReading;
+
+    void advance();
+    void makeReading(uint8_t osr);
+    static void rotate(double *phasor, const double *step);
+    static void setStep(double *step, double periodSeconds, uint32_t ms);
+    float uniform();
+    float gaussian();
+};
+
+#endif
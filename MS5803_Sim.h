@@ -0,0 +1,42 @@
+/*
+ *  MS5803_Sim
+ *  	Interface of a simulated MS5803. An MS_5803 given one with 
+ *  	setSimulator() sends it its commands instead of using the I2C bus, so
+ *  	everything from MS_5803_ADC() upward can run against recorded or
+ *  	generated data, on the board or on a host, faster than real time.
+ *
+ *  	See MS5803_Replay.h for a simulator fed by recorded traces.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_SIM__
+#define __MS_5803_SIM__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+class MS_5803_SimDevice {
+public:
+    virtual ~MS_5803_SimDevice() {}
+    // Reset command
+    virtual void reset() {}
+    // Word 'index' (0-7) of the PROM
+    virtual uint16_t prom(uint8_t index) = 0;
+    // Start of an ADC conversion. 'command' holds CMD_ADC_D1 or CMD_ADC_D2
+    // and the OSR bits (CMD_ADC_256..CMD_ADC_4096). Returns the 24-bit 
+    // result the next ADC read will give.
+    virtual uint32_t convert(char command) = 0;
+    
+    // Helpers for decoding the command
+    static boolean isTemperature(char command) {return command & CMD_ADC_D2;}
+    static uint16_t resolution(char command) {
+        return 256U << min((command & 0x0F) >> 1, 4);
+    }
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ *  MS5803_Stats
+ *  	Online statistics of MS5803 readings. See MS5803_Stats.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Stats.h"
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Stats::MS_5803_Stats() {
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_Stats::reset() {
+    n = 0;
+    _min = 0;
+    _max = 0;
+    origin = 0;
+    _mean = 0;
+    m2 = 0;
+}
+
+//-------------------------------------------------
+void MS_5803_Stats::add(int32_t value) {
+    if (n == 0) {
+    	origin = value;
+    	_min = value;
+    	_max = value;
+    } else if (value < _min) {
+    	_min = value;
+    } else if (value > _max) {
+    	_max = value;
+    }
+    n++;
+    // Welford's update on the value relative to the window origin
+    double x = value - origin;
+    double delta = x - _mean;
+    _mean += delta / n;
+    m2 += delta * (x - _mean);
+}
+
+//-------------------------------------------------
+void MS_5803_Stats::merge(const MS_5803_Stats &other) {
+    if (other.n == 0) {
+    	return;
+    }
+    if (n == 0) {
+    	*this = other;
+    	return;
+    }
+    // Chan's pairwise update, with the other mean moved to this origin
+    double otherMean = (double)(other.origin - origin) + other._mean;
+    double delta = otherMean - _mean;
+    uint32_t total = n + other.n;
+    _mean += delta * other.n / total;
+    m2 += other.m2 + delta * delta * ((double)n * other.n / total);
+    n = total;
+    _min = min(_min, other._min);
+    _max = max(_max, other._max);
+}
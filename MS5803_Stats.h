@@ -0,0 +1,71 @@
+/*
+ *  MS5803_Stats
+ *  	Online statistics (count, mean, variance, min, max) of MS5803 readings
+ *  	using Welford's update, for per-window summaries. Each update is O(1),
+ *  	accumulators can be reset at the start of a window, and accumulators 
+ *  	from different windows or sensors can be merged (Chan et al.), e.g. to
+ *  	aggregate on a host in parallel.
+ *
+ *  	Values are the integer readings of MS_5803::pressureInt() and 
+ *  	temperatureInt(). The running sums are kept relative to the first value
+ *  	of the window so that they stay small enough for single precision on 
+ *  	8-bit Arduinos, where double is the same as float.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_STATS__
+#define __MS_5803_STATS__
+
+#include <Arduino.h>
+#include "MS5803_05.h"
+
+class MS_5803_Stats {
+public:
+    MS_5803_Stats();
+    // Start a new window
+    void reset();
+    // Add one value
+    void add(int32_t value);
+    // Merge another accumulator into this one
+    void merge(const MS_5803_Stats &other);
+    
+    uint32_t count() const          {return n;}
+    int32_t minimum() const         {return _min;}
+    int32_t maximum() const         {return _max;}
+    double mean() const             {return n ? origin + _mean : 0;}
+    // Sample variance (divides by count - 1), 0 for fewer than 2 values
+    double variance() const         {return n > 1 ? m2 / (n - 1) : 0;}
+    
+private:
+    uint32_t n;
+    int32_t _min;
+    int32_t _max;
+    // First value of the window; the mean is kept relative to it
+    int32_t origin;
+    double _mean;
+    double m2;
+};
+
+// Pressure and temperature statistics for one sensor
+class MS_5803_ReadingStats {
+public:
+    // Start a new window
+    void reset()                    {pressure.reset(); temperature.reset();}
+    // Add the latest reading of a sensor (after readSensor())
+    void add(const MS_5803 &sensor) {pressure.add(sensor.pressureInt());
+                                     temperature.add(sensor.temperatureInt());}
+    void merge(const MS_5803_ReadingStats &other) {
+        pressure.merge(other.pressure);
+        temperature.merge(other.temperature);
+    }
+    
+    MS_5803_Stats pressure;    // 0.01 mbar
+    MS_5803_Stats temperature; // 0.01 C
+};
+
+#endif
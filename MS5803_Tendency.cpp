@@ -0,0 +1,187 @@
+/*
+ *  MS5803_Tendency
+ *  	Barometric tendency, WMO characteristic and alerts. See 
+ *  	MS5803_Tendency.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Tendency.h"
+
+// Slots per hour
+#define PER_HOUR (3600 / MS5803_TENDENCY_SLOT)
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Tendency::MS_5803_Tendency(int32_t alert, int32_t steady) {
+    _alert = alert;
+    _steady = steady;
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_Tendency::reset() {
+    for (uint8_t i = 0; i < MS5803_TENDENCY_SLOTS; i++) {
+    	slots[i] = MS5803_TENDENCY_MISSING;
+    }
+    head = 0;
+    current = 0;
+    first = 0;
+    sum = 0;
+    count = 0;
+    started = false;
+    _alerts = MS5803_TENDENCY_NONE;
+}
+
+//-------------------------------------------------
+uint8_t MS_5803_Tendency::add(uint32_t seconds, int32_t pressure) {
+    uint32_t number = seconds / MS5803_TENDENCY_SLOT;
+    if (!started) {
+    	started = true;
+    	current = number;
+    }
+    if (number < current) {
+    	return MS5803_TENDENCY_NONE;
+    }
+    uint8_t raised = MS5803_TENDENCY_NONE;
+    if (number > current) {
+    	// Close the slot being filled, and mark any skipped ones missing
+    	push(count ? first + sum / count : MS5803_TENDENCY_MISSING);
+    	uint32_t skipped = number - current - 1;
+    	for (uint32_t i = 0; i < skipped && i < MS5803_TENDENCY_SLOTS; i++) {
+    		push(MS5803_TENDENCY_MISSING);
+    	}
+    	current = number;
+    	count = 0;
+    	sum = 0;
+    	// Alerts only change when a slot closes
+    	int32_t delta = change(3);
+    	uint8_t now = MS5803_TENDENCY_NONE;
+    	if (delta != MS5803_TENDENCY_MISSING) {
+    		int32_t limit = _alerts ? _alert * 3 / 4 : _alert;
+    		if (delta >= limit) {
+    			now = MS5803_TENDENCY_RISING;
+    		}
+    		else if (-delta >= limit) {
+    			now = MS5803_TENDENCY_FALLING;
+    		}
+    	}
+    	raised = now & ~_alerts;
+    	_alerts = now;
+    }
+    if (count == 0) {
+    	first = pressure;
+    }
+    // Stop adding at the limit of the count; the mean is as good by then
+    if (count < 0xFFFF) {
+    	sum += pressure - first;
+    	count++;
+    }
+    return raised;
+}
+
+//-------------------------------------------------
+void MS_5803_Tendency::push(int32_t mean) {
+    head = (head + 1) % MS5803_TENDENCY_SLOTS;
+    slots[head] = mean;
+}
+
+//-------------------------------------------------
+int32_t MS_5803_Tendency::slot(uint8_t back) const {
+    return slots[(head + MS5803_TENDENCY_SLOTS - back) % MS5803_TENDENCY_SLOTS];
+}
+
+//-------------------------------------------------
+// Change from 'from' slots back to 'to' slots back
+int32_t MS_5803_Tendency::between(uint8_t from, uint8_t to) const {
+    int32_t a = slot(from);
+    int32_t b = slot(to);
+    if (a == MS5803_TENDENCY_MISSING || b == MS5803_TENDENCY_MISSING) {
+    	return MS5803_TENDENCY_MISSING;
+    }
+    return b - a;
+}
+
+//-------------------------------------------------
+int32_t MS_5803_Tendency::change(uint8_t hours) const {
+    if (hours < 1 || hours > 6) {
+    	return MS5803_TENDENCY_MISSING;
+    }
+    return between(hours * PER_HOUR, 0);
+}
+
+//-------------------------------------------------
+float MS_5803_Tendency::rate(uint8_t hours) const {
+    int32_t delta = change(hours);
+    if (delta == MS5803_TENDENCY_MISSING) {
+    	return NAN;
+    }
+    return delta / (100.0 * hours);
+}
+
+//-------------------------------------------------
+// The 3 hours are split in two halves, each increasing, steady or 
+// decreasing, and the overall change decides between the codes that 
+// share a shape (e.g. 0 and 8, "increasing then decreasing").
+uint8_t MS_5803_Tendency::characteristic() const {
+    int32_t early = between(3 * PER_HOUR, 3 * PER_HOUR / 2);
+    int32_t late = between(3 * PER_HOUR / 2, 0);
+    if (early == MS5803_TENDENCY_MISSING || late == MS5803_TENDENCY_MISSING) {
+    	return MS5803_TENDENCY_UNKNOWN;
+    }
+    int32_t net = early + late;
+    boolean upFirst = early > _steady;
+    boolean downFirst = early < -_steady;
+    boolean upLast = late > _steady;
+    boolean downLast = late < -_steady;
+    if (net > _steady) {
+    	if (upFirst && downLast) {
+    		return 0; // increasing, then decreasing
+    	}
+    	if (upFirst && !upLast) {
+    		return 1; // increasing, then steady
+    	}
+    	if (upFirst && late < early - _steady) {
+    		return 1; // increasing, then increasing more slowly
+    	}
+    	if (!upFirst || late > early + _steady) {
+    		return 3; // steady or decreasing then increasing, or faster
+    	}
+    	return 2; // increasing
+    }
+    if (net < -_steady) {
+    	if (downFirst && upLast) {
+    		return 5; // decreasing, then increasing
+    	}
+    	if (downFirst && !downLast) {
+    		return 6; // decreasing, then steady
+    	}
+    	if (downFirst && late > early + _steady) {
+    		return 6; // decreasing, then decreasing more slowly
+    	}
+    	if (!downFirst || late < early - _steady) {
+    		return 8; // steady or increasing then decreasing, or faster
+    	}
+    	return 7; // decreasing
+    }
+    if (upFirst && downLast) {
+    	return 0;
+    }
+    if (downFirst && upLast) {
+    	return 5;
+    }
+    return 4; // steady
+}
+
+//-------------------------------------------------
+float MS_5803_Tendency::forecast(float hours) const {
+    float trend = rate(3);
+    if (isnan(trend) || slot(0) == MS5803_TENDENCY_MISSING) {
+    	return NAN;
+    }
+    return slot(0) / 100.0 + trend * hours;
+}
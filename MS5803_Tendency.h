@@ -0,0 +1,86 @@
+/*
+ *  MS5803_Tendency
+ *  	Barometric tendency on the device: the change and rate of change of 
+ *  	pressure over the last 1, 3 and 6 hours, the WMO characteristic of the
+ *  	tendency over 3 hours (code table 0200, 0-8), a linear short-term 
+ *  	forecast, and alerts for rapid changes.
+ *
+ *  	Readings are averaged into 10 minute slots, and only the last 6 hours 
+ *  	of slot means are kept in a ring (about 150 bytes in all), so adding a
+ *  	reading is O(1) whatever the reading rate. Slots without readings are
+ *  	marked missing, and results that need them are unavailable. Times are 
+ *  	in seconds, so months of (virtual) time can be covered.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_TENDENCY__
+#define __MS_5803_TENDENCY__
+
+#include <Arduino.h>
+
+// Length of a slot in s, and slots kept (6 hours and the slot before)
+#define MS5803_TENDENCY_SLOT 600
+#define MS5803_TENDENCY_SLOTS 37
+// Value of a missing slot or an unavailable change
+#define MS5803_TENDENCY_MISSING ((int32_t)0x80000000)
+// Characteristic when there isn't 3 hours of history
+#define MS5803_TENDENCY_UNKNOWN 255
+// Alerts
+#define MS5803_TENDENCY_NONE    0
+#define MS5803_TENDENCY_RISING  1
+#define MS5803_TENDENCY_FALLING 2
+
+class MS_5803_Tendency {
+public:
+    // 'alert' is the change over 3 hours (0.01 mbar) that raises an alert;
+    // it clears when the change is back under 3/4 of it. The default is the
+    // 3.6 mbar of "falling rapidly" in shipping forecasts. Changes of up to
+    // 'steady' (0.01 mbar) over half the 3 hour period count as steady.
+    MS_5803_Tendency(int32_t alert = 360, int32_t steady = 10);
+    // Forget the history
+    void reset();
+    // Add a reading (0.01 mbar, e.g. pressureInt()) taken at 'seconds'. 
+    // Readings older than the last one are ignored. Returns the alerts 
+    // raised by this reading (MS5803_TENDENCY_RISING or _FALLING), if any.
+    uint8_t add(uint32_t seconds, int32_t pressure);
+    
+    // Change (0.01 mbar) over the last 'hours' (1 to 6) of complete slots,
+    // or MS5803_TENDENCY_MISSING
+    int32_t change(uint8_t hours) const;
+    // Rate of change in mbar per hour over 'hours', or NAN
+    float rate(uint8_t hours) const;
+    // WMO characteristic of the last 3 hours (0-8), or 
+    // MS5803_TENDENCY_UNKNOWN
+    uint8_t characteristic() const;
+    // Pressure (mbar) expected 'hours' ahead from the 3 hour trend, or NAN
+    float forecast(float hours) const;
+    // Alerts currently raised
+    uint8_t alerts() const          {return _alerts;}
+
+private:
+    int32_t _alert;
+    int32_t _steady;
+    // Ring of slot means, 0.01 mbar; head is the latest complete slot
+    int32_t slots[MS5803_TENDENCY_SLOTS];
+    uint8_t head;
+    // Slot being filled: its number, first reading, and the sum of the 
+    // readings relative to the first
+    uint32_t current;
+    int32_t first;
+    int32_t sum;
+    uint16_t count;
+    boolean started;
+    uint8_t _alerts;
+    
+    void push(int32_t mean);
+    // Mean of the slot 'back' slots before the latest complete one
+    int32_t slot(uint8_t back) const;
+    int32_t between(uint8_t from, uint8_t to) const;
+};
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ *  MS5803_Tides
+ *  	Streaming harmonic analysis of tides. See MS5803_Tides.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Tides.h"
+
+// Periods of the constituents in seconds, in the order of the MS5803_TIDE_ 
+// bits
+static const double tidePeriods[MS5803_TIDE_COUNT] = {
+    44714.164,  // M2
+    43200.0,    // S2
+    45570.054,  // N2
+    43082.045,  // K2
+    86164.091,  // K1
+    92949.630,  // O1
+    86637.205,  // P1
+    96726.084,  // Q1
+    22357.082   // M4
+};
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Tides::MS_5803_Tides(uint16_t constituents, uint32_t epoch) {
+    _constituents = constituents & ((1 << MS5803_TIDE_COUNT) - 1);
+    _epoch = epoch;
+    epochFirst = epoch == MS5803_TIDE_EPOCH_FIRST;
+    terms = 1;
+    for (uint8_t i = 0; i < MS5803_TIDE_COUNT; i++) {
+    	index[i] = 0;
+    	if (_constituents & (1 << i)) {
+    		index[i] = terms;
+    		terms += 2;
+    	}
+    }
+    reset();
+}
+
+//-------------------------------------------------
+void MS_5803_Tides::reset() {
+    if (epochFirst) {
+    	_epoch = MS5803_TIDE_EPOCH_FIRST;
+    }
+    n = 0;
+    origin = 0;
+    memset(ata, 0, sizeof(ata));
+    memset(aty, 0, sizeof(aty));
+    yy = 0;
+    memset(coef, 0, sizeof(coef));
+    _rms = 0;
+}
+
+//-------------------------------------------------
+void MS_5803_Tides::add(uint32_t seconds, float value) {
+    if (n == 0) {
+    	origin = value;
+    	if (epochFirst) {
+    		_epoch = seconds;
+    	}
+    }
+    double row[MS5803_TIDE_TERMS];
+    basis(seconds, row);
+    double y = value - origin;
+    for (uint8_t i = 0; i < terms; i++) {
+    	double *sums = &ata[cell(i, 0)];
+    	for (uint8_t j = 0; j <= i; j++) {
+    		sums[j] += row[i] * row[j];
+    	}
+    	aty[i] += row[i] * y;
+    }
+    yy += y * y;
+    n++;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Tides::merge(const MS_5803_Tides &other) {
+    if (other.n == 0) {
+    	return other._constituents == _constituents;
+    }
+    // An empty accumulator waiting for its first reading takes the other's
+    // epoch
+    if (n == 0 && epochFirst) {
+    	_epoch = other._epoch;
+    }
+    if (other._constituents != _constituents || other._epoch != _epoch) {
+    	return false;
+    }
+    if (n == 0) {
+    	origin = other.origin;
+    }
+    // The other values are relative to its own origin. The first term of
+    // the fit is 1, so column 0 of its normal matrix holds the sums of the
+    // other terms needed to move them to ours.
+    double shift = (double)other.origin - origin;
+    double sumY = other.aty[0] + shift * other.n;
+    yy += other.yy + 2 * shift * other.aty[0] + shift * shift * other.n;
+    for (uint8_t i = 0; i < terms; i++) {
+    	for (uint8_t j = 0; j <= i; j++) {
+    		ata[cell(i, j)] += other.ata[cell(i, j)];
+    	}
+    	aty[i] += i == 0 ? sumY : other.aty[i] + shift * other.ata[cell(i, 0)];
+    }
+    n += other.n;
+    return true;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Tides::solve() {
+    if (n < terms) {
+    	return false;
+    }
+    // Cholesky factorisation L L^T of the normal matrix, then forward and
+    // back substitution. A pivot that is tiny compared to the diagonal
+    // means the constituents can't be told apart yet.
+    double l[MS5803_TIDE_TERMS * (MS5803_TIDE_TERMS + 1) / 2];
+    double x[MS5803_TIDE_TERMS];
+    boolean ok = true;
+    for (uint8_t i = 0; i < terms && ok; i++) {
+    	for (uint8_t j = 0; j <= i; j++) {
+    		double sum = ata[cell(i, j)];
+    		for (uint8_t k = 0; k < j; k++) {
+    			sum -= l[cell(i, k)] * l[cell(j, k)];
+    		}
+    		if (i == j) {
+    			if (sum <= ata[cell(i, i)] * 1e-6) {
+    				ok = false;
+    				break;
+    			}
+    			l[cell(i, i)] = sqrt(sum);
+    		}
+    		else {
+    			l[cell(i, j)] = sum / l[cell(j, j)];
+    		}
+    	}
+    }
+    if (ok) {
+    	for (uint8_t i = 0; i < terms; i++) {
+    		double sum = aty[i];
+    		for (uint8_t k = 0; k < i; k++) {
+    			sum -= l[cell(i, k)] * x[k];
+    		}
+    		x[i] = sum / l[cell(i, i)];
+    	}
+    	for (int8_t i = terms - 1; i >= 0; i--) {
+    		double sum = x[i];
+    		for (uint8_t k = i + 1; k < terms; k++) {
+    			sum -= l[cell(k, i)] * x[k];
+    		}
+    		x[i] = sum / l[cell(i, i)];
+    	}
+    	// At the least squares solution the residual sum of squares is
+    	// y.y - x.(A^T y)
+    	double rss = yy;
+    	for (uint8_t i = 0; i < terms; i++) {
+    		coef[i] = x[i];
+    		rss -= x[i] * aty[i];
+    	}
+    	_rms = rss > 0 ? sqrt(rss / n) : 0;
+    }
+    return ok;
+}
+
+//-------------------------------------------------
+float MS_5803_Tides::amplitude(uint16_t constituent) const {
+    for (uint8_t i = 0; i < MS5803_TIDE_COUNT; i++) {
+    	if (constituent == (1 << i) && index[i]) {
+    		return sqrt(coef[index[i]] * coef[index[i]] 
+    				+ coef[index[i] + 1] * coef[index[i] + 1]);
+    	}
+    }
+    return 0;
+}
+
+//-------------------------------------------------
+float MS_5803_Tides::phase(uint16_t constituent) const {
+    for (uint8_t i = 0; i < MS5803_TIDE_COUNT; i++) {
+    	if (constituent == (1 << i) && index[i]) {
+    		float degrees = atan2(coef[index[i] + 1], coef[index[i]]) * RAD_TO_DEG;
+    		return degrees < 0 ? degrees + 360 : degrees;
+    	}
+    }
+    return 0;
+}
+
+//-------------------------------------------------
+float MS_5803_Tides::predict(uint32_t seconds) const {
+    double row[MS5803_TIDE_TERMS];
+    basis(seconds, row);
+    double sum = origin;
+    for (uint8_t i = 0; i < terms; i++) {
+    	sum += coef[i] * row[i];
+    }
+    return sum;
+}
+
+//-------------------------------------------------
+void MS_5803_Tides::basis(uint32_t seconds, double *row) const {
+    // Reduce the time to within one period first, so that the angle keeps
+    // its precision for long records
+    double t = (double)(int32_t)(seconds - _epoch);
+    row[0] = 1;
+    for (uint8_t i = 0; i < MS5803_TIDE_COUNT; i++) {
+    	if (index[i]) {
+    		double angle = 2 * PI * fmod(t, tidePeriods[i]) / tidePeriods[i];
+    		row[index[i]] = cos(angle);
+    		row[index[i] + 1] = sin(angle);
+    	}
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ *  MS5803_Tides
+ *  	Streaming harmonic analysis of tides from MS5803 pressure or depth
+ *  	readings. Each reading updates the normal equations of the least
+ *  	squares fit
+ *  		value = Z0 + sum of A cos(w (t - epoch) - phase)
+ *  	over the chosen constituents, so memory is O(constituents^2) whatever
+ *  	the length of the record. The amplitudes and phases can be solved for
+ *  	at any time (Cholesky factorisation), and the fit then gives the 
+ *  	predicted tide and the residual (surge) of new readings.
+ *
+ *  	Accumulators with the same constituents and epoch can be merged, e.g.
+ *  	to analyse years of archives in parallel on a host and combine the
+ *  	partial sums. Nodal corrections are not applied, so records much 
+ *  	longer than a year give the mean amplitudes over the 18.6 year cycle.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_TIDES__
+#define __MS_5803_TIDES__
+
+#include <Arduino.h>
+
+// Constituents, to combine with |
+#define MS5803_TIDE_M2 0x001
+#define MS5803_TIDE_S2 0x002
+#define MS5803_TIDE_N2 0x004
+#define MS5803_TIDE_K2 0x008
+#define MS5803_TIDE_K1 0x010
+#define MS5803_TIDE_O1 0x020
+#define MS5803_TIDE_P1 0x040
+#define MS5803_TIDE_Q1 0x080
+#define MS5803_TIDE_M4 0x100
+#define MS5803_TIDE_COUNT 9
+// Unknowns of the fit: the mean and a cosine and sine term per constituent
+#define MS5803_TIDE_TERMS (1 + 2 * MS5803_TIDE_COUNT)
+// Epoch meaning "the time of the first reading"
+#define MS5803_TIDE_EPOCH_FIRST 0xFFFFFFFF
+
+class MS_5803_Tides {
+public:
+    // Times are in seconds (e.g. Unix time) and phases are relative to 
+    // 'epoch', by default the time of the first reading. Times must be 
+    // within 68 years of the epoch. On 8-bit boards, where double is single
+    // precision, the epoch should be near the data. Accumulators that will
+    // be merged need the same, explicit, epoch.
+    MS_5803_Tides(uint16_t constituents = MS5803_TIDE_M2 | MS5803_TIDE_S2 
+                      | MS5803_TIDE_K1 | MS5803_TIDE_O1, 
+                  uint32_t epoch = MS5803_TIDE_EPOCH_FIRST);
+    // Forget all readings (and the first reading's epoch)
+    void reset();
+    // Add a reading taken at 'seconds'. Any unit can be used for the value
+    // (e.g. 0.01 mbar from pressureInt(), or m of depth); the amplitudes 
+    // are in the same unit.
+    void add(uint32_t seconds, float value);
+    // Add the readings of another accumulator. Returns false if its
+    // constituents or epoch differ.
+    boolean merge(const MS_5803_Tides &other);
+    // Solve the fit with the readings so far. Returns false if there are too
+    // few readings, or the record is too short to separate the constituents
+    // (e.g. S2 and K2 need about 6 months). The factorisation is done on 
+    // the stack, which needs as much again as the normal matrix (760 bytes
+    // on AVR, 1520 elsewhere, with all the constituents).
+    boolean solve();
+    
+    uint32_t count() const          {return n;}
+    // Time the phases are relative to, MS5803_TIDE_EPOCH_FIRST until the 
+    // first reading if it wasn't given
+    uint32_t epoch() const          {return _epoch;}
+    // Results of the last solve(). 'constituent' is one MS5803_TIDE_ value.
+    float mean() const              {return origin + coef[0];}
+    float amplitude(uint16_t constituent) const;
+    // Phase lag in degrees (0-360)
+    float phase(uint16_t constituent) const;
+    // RMS of the residuals of the fitted readings
+    float rms() const               {return _rms;}
+    // Tide predicted at 'seconds' and the residual (surge) of a reading
+    float predict(uint32_t seconds) const;
+    float residual(uint32_t seconds, float value) const {
+        return value - predict(seconds);
+    }
+
+private:
+    uint16_t _constituents;
+    uint32_t _epoch;
+    boolean epochFirst; // take the epoch from the first reading
+    uint8_t terms;
+    uint8_t index[MS5803_TIDE_COUNT]; // term of each constituent (0 if unused)
+    uint32_t n;
+    // First value added; the sums are kept relative to it
+    float origin;
+    // Packed lower triangle of the normal matrix, right hand side and sum 
+    // of squares
+    double ata[MS5803_TIDE_TERMS * (MS5803_TIDE_TERMS + 1) / 2];
+    double aty[MS5803_TIDE_TERMS];
+    double yy;
+    // Solution
+    float coef[MS5803_TIDE_TERMS];
+    float _rms;
+    
+    // Fills row with the terms of the fit at 'seconds'
+    void basis(uint32_t seconds, double *row) const;
+    static uint16_t cell(uint8_t i, uint8_t j) {return i * (i + 1) / 2 + j;}
+};
+
+#endif
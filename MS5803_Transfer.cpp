@@ -0,0 +1,339 @@
+/*
+ *  MS5803_Transfer
+ *  	Resumable, windowed log transfer with per-block CRC. See 
+ *  	MS5803_Transfer.h.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#include "MS5803_Transfer.h"
+
+#define FRAME_START 0xA5
+// Frame types
+#define FRAME_HELLO 1 // sender asks where to start; block is the total
+#define FRAME_ACK   2 // block is the next one needed; payload is a bitmap
+#define FRAME_DATA  3
+#define FRAME_LAST  4 // data of the last block
+// Bytes before the payload
+#define HEADER 10
+
+//-------------------------------------------------
+uint16_t MS_5803_MemorySource::read(uint32_t offset, uint8_t *data, 
+                                    uint16_t length) {
+    if (offset >= _size) {
+    	return 0;
+    }
+    if (length > _size - offset) {
+    	length = _size - offset;
+    }
+    memcpy(data, _data + offset, length);
+    return length;
+}
+
+//-------------------------------------------------
+// Constructor
+MS_5803_Transfer::MS_5803_Transfer(Stream &link, uint16_t session, 
+                                   uint16_t inPayload, uint16_t outPayload) {
+    _link = &link;
+    _session = session;
+    sent = 0;
+    bad = 0;
+    capacity = inPayload + MS5803_TRANSFER_OVERHEAD;
+    frame = new uint8_t[capacity];
+    received = 0;
+    out = new uint8_t[outPayload + MS5803_TRANSFER_OVERHEAD];
+    frameType = 0;
+    frameSession = 0;
+    frameBlock = 0;
+    frameLength = 0;
+}
+
+MS_5803_Transfer::~MS_5803_Transfer() {
+    delete[] frame;
+    delete[] out;
+}
+
+//-------------------------------------------------
+uint16_t MS_5803_Transfer::crc16(const uint8_t *data, uint16_t length, 
+                                 uint16_t crc) {
+    while (length--) {
+    	crc ^= (uint16_t)*data++ << 8;
+    	for (uint8_t bit = 0; bit < 8; bit++) {
+    		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    	}
+    }
+    return crc;
+}
+
+//-------------------------------------------------
+boolean MS_5803_Transfer::readFrame() {
+    while (_link->available() > 0) {
+    	int c = _link->read();
+    	if (c < 0) {
+    		break;
+    	}
+    	if (received == 0 && c != FRAME_START) {
+    		continue;
+    	}
+    	frame[received++] = c;
+    	if (received < HEADER) {
+    		continue;
+    	}
+    	uint16_t length = frame[8] | (uint16_t)frame[9] << 8;
+    	if (length + MS5803_TRANSFER_OVERHEAD > capacity) {
+    		// Too long to be ours: a damaged header. Look for the next start.
+    		bad++;
+    		received = 0;
+    		continue;
+    	}
+    	if (received < length + MS5803_TRANSFER_OVERHEAD) {
+    		continue;
+    	}
+    	received = 0;
+    	uint16_t crc = frame[HEADER + length] 
+    			| (uint16_t)frame[HEADER + length + 1] << 8;
+    	if (crc != crc16(frame + 1, HEADER - 1 + length)) {
+    		bad++;
+    		continue;
+    	}
+    	frameType = frame[1];
+    	frameSession = frame[2] | (uint16_t)frame[3] << 8;
+    	frameBlock = frame[4] | (uint32_t)frame[5] << 8 
+    			| (uint32_t)frame[6] << 16 | (uint32_t)frame[7] << 24;
+    	frameLength = length;
+    	return true;
+    }
+    return false;
+}
+
+//-------------------------------------------------
+void MS_5803_Transfer::sendFrame(uint8_t type, uint32_t block, 
+                                 const uint8_t *payload, uint16_t length) {
+    out[0] = FRAME_START;
+    out[1] = type;
+    out[2] = _session;
+    out[3] = _session >> 8;
+    out[4] = block;
+    out[5] = block >> 8;
+    out[6] = block >> 16;
+    out[7] = block >> 24;
+    out[8] = length;
+    out[9] = length >> 8;
+    if (length && payload != out + HEADER) {
+    	memcpy(out + HEADER, payload, length);
+    }
+    uint16_t crc = crc16(out + 1, HEADER - 1 + length);
+    out[HEADER + length] = crc;
+    out[HEADER + length + 1] = crc >> 8;
+    // One write per frame, so packet links send it as one packet
+    _link->write(out, length + MS5803_TRANSFER_OVERHEAD);
+    sent++;
+}
+
+//-------------------------------------------------
+// Constructor
+MS_5803_TransferSender::MS_5803_TransferSender(Stream &link, 
+        MS_5803_BlockSource &source, uint16_t session, uint16_t blockSize, 
+        uint8_t window, uint32_t timeoutMs) 
+        : MS_5803_Transfer(link, session, 4, blockSize ? blockSize : 1) {
+    _source = &source;
+    _blockSize = blockSize ? blockSize : 1;
+    _window = constrain(window, 1, MS5803_TRANSFER_MAX_WINDOW);
+    _timeout = timeoutMs;
+    uint32_t size = source.size();
+    blocks = size ? (size + _blockSize - 1) / _blockSize : 1;
+    base = 0;
+    connected = false;
+    helloMs = 0;
+    helloSent = false;
+    sentBits = 0;
+    ackBits = 0;
+    resent = 0;
+}
+
+//-------------------------------------------------
+boolean MS_5803_TransferSender::poll(uint32_t ms) {
+    while (readFrame()) {
+    	if (frameType == FRAME_ACK && frameSession == _session 
+    			&& frameLength == 4) {
+    		const uint8_t *p = framePayload();
+    		acknowledge(frameBlock, p[0] | (uint32_t)p[1] << 8 
+    				| (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+    		connected = true;
+    	}
+    }
+    // Ask the receiver where to start before sending anything
+    if (!connected) {
+    	if (!helloSent || ms - helloMs >= _timeout) {
+    		sendFrame(FRAME_HELLO, blocks, NULL, 0);
+    		helloSent = true;
+    		helloMs = ms;
+    	}
+    	return false;
+    }
+    // Send the blocks of the window not sent yet, and again those not
+    // acknowledged in time
+    for (uint8_t i = 0; i < _window && base + i < blocks; i++) {
+    	uint32_t block = base + i;
+    	uint32_t bit = 1UL << (block % MS5803_TRANSFER_MAX_WINDOW);
+    	if (ackBits & bit) {
+    		continue;
+    	}
+    	if (!(sentBits & bit)) {
+    		sendBlock(block, ms);
+    	}
+    	else if (ms - sentMs[block % MS5803_TRANSFER_MAX_WINDOW] >= _timeout) {
+    		resent++;
+    		sendBlock(block, ms);
+    	}
+    }
+    return done();
+}
+
+//-------------------------------------------------
+void MS_5803_TransferSender::acknowledge(uint32_t next, uint32_t bitmap) {
+    if (next > blocks) {
+    	next = blocks;
+    }
+    if (next < base) {
+    	// The receiver lost blocks it had acknowledged (e.g. it restarted
+    	// without saving its state): go back.
+    	base = next;
+    	sentBits = 0;
+    	ackBits = 0;
+    }
+    while (base < next) {
+    	uint32_t bit = 1UL << (base % MS5803_TRANSFER_MAX_WINDOW);
+    	sentBits &= ~bit;
+    	ackBits &= ~bit;
+    	base++;
+    }
+    // Blocks after 'next' the receiver already holds
+    for (uint8_t i = 0; i + 1 < _window && bitmap; i++, bitmap >>= 1) {
+    	if (bitmap & 1) {
+    		ackBits |= 1UL << ((next + 1 + i) % MS5803_TRANSFER_MAX_WINDOW);
+    	}
+    }
+}
+
+//-------------------------------------------------
+void MS_5803_TransferSender::sendBlock(uint32_t block, uint32_t ms) {
+    uint16_t length = _source->read(block * _blockSize, outPayload(), 
+                                    _blockSize);
+    sendFrame(block + 1 == blocks ? FRAME_LAST : FRAME_DATA, block, 
+              outPayload(), length);
+    sentBits |= 1UL << (block % MS5803_TRANSFER_MAX_WINDOW);
+    sentMs[block % MS5803_TRANSFER_MAX_WINDOW] = ms;
+}
+
+//-------------------------------------------------
+// Constructor
+MS_5803_TransferReceiver::MS_5803_TransferReceiver(Stream &link, Print &out,
+        uint16_t blockSize, uint8_t window, uint32_t timeoutMs)
+        : MS_5803_Transfer(link, 0, blockSize ? blockSize : 1, 4) {
+    _output = &out;
+    _blockSize = blockSize ? blockSize : 1;
+    _window = constrain(window, 1, MS5803_TRANSFER_MAX_WINDOW);
+    _timeout = timeoutMs;
+    blocks = new uint8_t[(uint32_t)_window * _blockSize];
+    have = 0;
+    next = 0;
+    last = 0xFFFFFFFF;
+    finished = false;
+    started = false;
+    ackMs = 0;
+}
+
+MS_5803_TransferReceiver::~MS_5803_TransferReceiver() {
+    delete[] blocks;
+}
+
+//-------------------------------------------------
+void MS_5803_TransferReceiver::restart(uint16_t session) {
+    _session = session;
+    have = 0;
+    next = 0;
+    last = 0xFFFFFFFF;
+    finished = false;
+    started = true;
+}
+
+//-------------------------------------------------
+void MS_5803_TransferReceiver::resume(uint16_t session, uint32_t block) {
+    restart(session);
+    next = block;
+}
+
+//-------------------------------------------------
+boolean MS_5803_TransferReceiver::poll(uint32_t ms) {
+    while (readFrame()) {
+    	if (frameType != FRAME_HELLO && frameType != FRAME_DATA 
+    			&& frameType != FRAME_LAST) {
+    		continue;
+    	}
+    	// A sender with another log starts a new session
+    	if (!started || frameSession != _session) {
+    		restart(frameSession);
+    	}
+    	if (frameType == FRAME_HELLO) {
+    		// The total number of blocks tells a resumed receiver whether 
+    		// it already has them all
+    		if (frameBlock && next >= frameBlock) {
+    			finished = true;
+    		}
+    		sendAck(ms);
+    		continue;
+    	}
+    	uint32_t block = frameBlock;
+    	if (frameType == FRAME_LAST) {
+    		last = block;
+    	}
+    	if (block >= next && block - next < _window 
+    			&& frameLength <= _blockSize) {
+    		uint8_t slot = block % _window;
+    		if (!(have & (1UL << slot))) {
+    			memcpy(blocks + (uint16_t)slot * _blockSize, framePayload(), 
+    			       frameLength);
+    			lengths[slot] = frameLength;
+    			have |= 1UL << slot;
+    		}
+    	}
+    	// Write out the blocks that are now in order
+    	while (have & (1UL << (next % _window))) {
+    		uint8_t slot = next % _window;
+    		_output->write(blocks + (uint16_t)slot * _blockSize, lengths[slot]);
+    		have &= ~(1UL << slot);
+    		next++;
+    	}
+    	if (last != 0xFFFFFFFF && next > last) {
+    		finished = true;
+    	}
+    	sendAck(ms);
+    }
+    // Repeat the acknowledgement now and then in case it was lost
+    if (started && !finished && ms - ackMs >= _timeout) {
+    	sendAck(ms);
+    }
+    return finished;
+}
+
+//-------------------------------------------------
+void MS_5803_TransferReceiver::sendAck(uint32_t ms) {
+    uint32_t bitmap = 0;
+    for (uint8_t i = 1; i < _window; i++) {
+    	if (have & (1UL << ((next + i) % _window))) {
+    		bitmap |= 1UL << (i - 1);
+    	}
+    }
+    uint8_t *p = outPayload();
+    p[0] = bitmap;
+    p[1] = bitmap >> 8;
+    p[2] = bitmap >> 16;
+    p[3] = bitmap >> 24;
+    sendFrame(FRAME_ACK, next, p, 4);
+    ackMs = ms;
+}
@@ -0,0 +1,183 @@
+/*
+ *  MS5803_Transfer
+ *  	Resumable bulk transfer of a log (e.g. the binary reading records of
+ *  	MS5803_Replay.h) from a node to a gateway over any byte transport 
+ *  	(a Stream: serial port, radio module, TCP client...). 
+ *
+ *  	The log is cut into numbered blocks, each sent in a frame with its 
+ *  	own CRC-16. Up to 'window' blocks are in flight at once; the gateway
+ *  	acknowledges the next block it needs plus a bitmap of the later 
+ *  	blocks it already has, so only lost or damaged blocks are sent again
+ *  	(selective repeat). The sender starts each connection by asking the
+ *  	receiver where it is, so after the link drops, or either side 
+ *  	restarts, the transfer resumes from the last acknowledged block 
+ *  	instead of the beginning.
+ *
+ *  	Frames are: 0xA5, type, session (2 bytes), block (4), length (2), 
+ *  	payload, CRC-16/CCITT of everything after 0xA5 (2), all little-endian.
+ *  	Both ends are polled from loop() and never block.
+ *
+ * 	Licensed under the GPL v3 license. 
+ * 	Please see accompanying LICENSE.md file for details on reuse and 
+ * 	redistribution.
+ *
+ *  Copyright Ben Chittle, 2022
+ */
+
+#ifndef __MS_5803_TRANSFER__
+#define __MS_5803_TRANSFER__
+
+#include <Arduino.h>
+
+// Largest window; acknowledgements carry a 32-bit bitmap
+#define MS5803_TRANSFER_MAX_WINDOW 32
+// Bytes of a frame besides the payload
+#define MS5803_TRANSFER_OVERHEAD 12
+
+// Where the sender reads the log from. Blocks that are sent again are read
+// again, so the source must allow reading any part at any time (a buffer,
+// a file on an SD card...).
+class MS_5803_BlockSource {
+public:
+    virtual ~MS_5803_BlockSource() {}
+    // Size of the log in bytes
+    virtual uint32_t size() = 0;
+    // Copy 'length' bytes from 'offset' into 'data'. Returns the number
+    // copied.
+    virtual uint16_t read(uint32_t offset, uint8_t *data, uint16_t length) = 0;
+};
+
+// A log held in memory
+class MS_5803_MemorySource : public MS_5803_BlockSource {
+public:
+    MS_5803_MemorySource(const uint8_t *data, uint32_t size) 
+        : _data(data), _size(size) {}
+    uint32_t size()                 {return _size;}
+    uint16_t read(uint32_t offset, uint8_t *data, uint16_t length);
+private:
+    const uint8_t *_data;
+    uint32_t _size;
+};
+
+// Framing shared by both ends
+class MS_5803_Transfer {
+public:
+    virtual ~MS_5803_Transfer();
+    MS_5803_Transfer(const MS_5803_Transfer &) = delete;
+    MS_5803_Transfer &operator=(const MS_5803_Transfer &) = delete;
+    uint16_t session() const        {return _session;}
+    // Frames sent, and frames received with a bad CRC
+    uint32_t framesSent() const     {return sent;}
+    uint32_t badFrames() const      {return bad;}
+    // CRC-16/CCITT (polynomial 0x1021), continuing from 'crc'
+    static uint16_t crc16(const uint8_t *data, uint16_t length, 
+                          uint16_t crc = 0xFFFF);
+
+protected:
+    // Largest payloads received and sent
+    MS_5803_Transfer(Stream &link, uint16_t session, uint16_t inPayload,
+                     uint16_t outPayload);
+    Stream *_link;
+    uint16_t _session;
+    uint32_t sent;
+    uint32_t bad;
+    // Frame being received, and frame being sent
+    uint8_t *frame;
+    uint16_t capacity;
+    uint16_t received;
+    uint8_t *out;
+    // Fields of the last complete frame from readFrame()
+    uint8_t frameType;
+    uint16_t frameSession;
+    uint32_t frameBlock;
+    uint16_t frameLength;
+    const uint8_t *framePayload() const {return frame + 10;}
+    uint8_t *outPayload()           {return out + 10;}
+    
+    // Read available bytes until a whole frame with a good CRC is in; 
+    // returns false when the link has no more bytes for now
+    boolean readFrame();
+    // Send a frame. The payload may already be in place, at outPayload().
+    void sendFrame(uint8_t type, uint32_t block, const uint8_t *payload,
+                   uint16_t length);
+};
+
+// The node end: sends a log
+class MS_5803_TransferSender : public MS_5803_Transfer {
+public:
+    // 'session' identifies the log (e.g. a file number); a receiver that
+    // was in the middle of another session starts over. Blocks are resent
+    // after 'timeoutMs' without an acknowledgement.
+    MS_5803_TransferSender(Stream &link, MS_5803_BlockSource &source, 
+                           uint16_t session, uint16_t blockSize = 64, 
+                           uint8_t window = 8, uint32_t timeoutMs = 500);
+    // Call often, with the current time. Returns true once every block has
+    // been acknowledged.
+    boolean poll(uint32_t ms);
+    boolean done() const            {return connected && base >= blocks;}
+    // Blocks acknowledged so far, and the total
+    uint32_t acknowledged() const   {return base;}
+    uint32_t totalBlocks() const    {return blocks;}
+    uint32_t retransmissions() const {return resent;}
+
+private:
+    MS_5803_BlockSource *_source;
+    uint16_t _blockSize;
+    uint8_t _window;
+    uint32_t _timeout;
+    uint32_t blocks;
+    // Oldest unacknowledged block
+    uint32_t base;
+    boolean connected;
+    uint32_t helloMs;
+    boolean helloSent;
+    // Per block in flight, indexed by block % 32: sent, acknowledged out 
+    // of order, and when it was last sent
+    uint32_t sentBits;
+    uint32_t ackBits;
+    uint32_t sentMs[MS5803_TRANSFER_MAX_WINDOW];
+    uint32_t resent;
+    
+    void acknowledge(uint32_t next, uint32_t bitmap);
+    void sendBlock(uint32_t block, uint32_t ms);
+};
+
+// The gateway end: receives a log and writes it, in order, to 'out'
+class MS_5803_TransferReceiver : public MS_5803_Transfer {
+public:
+    // 'blockSize' and 'window' must be at least the sender's. Needs 
+    // window * blockSize bytes to hold blocks that arrive out of order.
+    MS_5803_TransferReceiver(Stream &link, Print &out, 
+                             uint16_t blockSize = 64, uint8_t window = 8,
+                             uint32_t timeoutMs = 500);
+    ~MS_5803_TransferReceiver();
+    // Continue a session from block 'next', e.g. after a restart with the 
+    // values of session() and delivered() saved
+    void resume(uint16_t session, uint32_t next);
+    // Call often, with the current time. Returns true once the whole log 
+    // has been written.
+    boolean poll(uint32_t ms);
+    boolean done() const            {return finished;}
+    // Blocks written to 'out' so far
+    uint32_t delivered() const      {return next;}
+
+private:
+    Print *_output;
+    uint16_t _blockSize;
+    uint8_t _window;
+    uint32_t _timeout;
+    uint8_t *blocks;
+    uint16_t lengths[MS5803_TRANSFER_MAX_WINDOW];
+    // Blocks held, indexed by block % window
+    uint32_t have;
+    uint32_t next;
+    uint32_t last;
+    boolean finished;
+    boolean started;
+    uint32_t ackMs;
+    
+    void restart(uint16_t session);
+    void sendAck(uint32_t ms);
+};
+
+#endif
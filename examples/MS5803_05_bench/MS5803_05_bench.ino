@@ -0,0 +1,491 @@
+/* MS5803_05_bench.ino
+  Times the processing stages of the MS5803_05 library on the board it runs
+  on. No sensor is needed: readings are simulated. Results are printed to
+  the Serial terminal as one JSON object per line, e.g.
+    {"bench":"convertRaw","metric":"cycles","value":1234.0}
+  so that runs on different boards and library versions can be collected
+  and compared by a script.
+
+  Where the CPU has a cycle counter (ESP32, Cortex-M3 and up, RISC-V) 
+  cycles are counted directly. Elsewhere (e.g. AVR) they are derived from
+  micros() and the CPU clock, which is only accurate over many calls. For
+  code size, see the sizes reported by the Arduino IDE when compiling this
+  sketch with and without a stage.
+
+  Larger benchmarks need more RAM than an Uno has; lower the sensor counts
+  below on small boards.
+*/
+
+#include <MS5803_05.h>
+#include <MS5803_Array.h>
+#include <MS5803_Kalman.h>
+#include <MS5803_MultiRate.h>
+#include <MS5803_Resample.h>
+#include <MS5803_Publish.h>
+#include <MS5803_Arrow.h>
+#include <MS5803_LUT.h>
+#include <MS5803_CommandList.h>
+#include <MS5803_SignalGen.h>
+#include <MS5803_Query.h>
+
+// Number of simulated readings per sensor in the array benchmark
+#define ARRAY_READINGS 100
+// Number of conversions timed in the conversion benchmark
+#define CONVERT_CALLS 1000
+// Readings per second, and length of the moving average compared with the
+// Kalman filters in the vertical speed benchmark
+#define KALMAN_RATE 20
+#define MOVING_AVERAGE 16
+// Readings fed to the multi-rate benchmark (one minute at 50 Hz)
+#define MULTIRATE_READINGS 3000
+// Irregular readings fed to the resampling benchmark
+#define RESAMPLE_READINGS 2000
+// Readings published (from 4 sensors) in the publishing benchmark
+#define PUBLISH_READINGS 2000
+// Readings exported, and rows per Arrow record batch, in the export 
+// benchmark
+#define EXPORT_READINGS 2000
+#define EXPORT_BATCH 128
+// Ticks of the 4 sensor schedule in the command list benchmark
+#define SCHEDULE_TICKS 1000
+// Readings logged (from 4 sensors over 8 days), and rows per batch, in the
+// query benchmark
+#define QUERY_READINGS 8192
+#define QUERY_BATCH 128
+
+MS_5803 sensor = MS_5803(512);
+MS_5803_LUT lut(2048);
+
+//-------------------------------------------------
+// Cycle counter of the CPU, or an estimate from micros()
+#if defined(ESP32)
+uint32_t cycles() { return ESP.getCycleCount(); }
+#elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#define DWT_CTRL   (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+#define DEM_CR     (*(volatile uint32_t *)0xE000EDFC)
+uint32_t cycles() {
+  if (!(DWT_CTRL & 1)) {
+    DEM_CR |= 0x01000000; // enable trace
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= 1;        // enable the cycle counter
+  }
+  return DWT_CYCCNT;
+}
+#elif defined(__riscv)
+uint32_t cycles() {
+  uint32_t c;
+  asm volatile("rdcycle %0" : "=r"(c));
+  return c;
+}
+#else
+uint32_t cycles() { return micros() * (F_CPU / 1000000UL); }
+#endif
+
+//-------------------------------------------------
+// Print one result as a line of JSON
+void report(const char *bench, const char *metric, float value) {
+  Serial.print("{\"bench\":\"");
+  Serial.print(bench);
+  Serial.print("\",\"metric\":\"");
+  Serial.print(metric);
+  Serial.print("\",\"value\":");
+  Serial.print(value, 3);
+  Serial.println("}");
+}
+
+//-------------------------------------------------
+// Time convertRaw() with the given conversion method on raw values spread
+// over the sensor's range, using the example coefficients from the MS5803
+// data sheet.
+void benchConvert(const char *name, uint8_t conversion) {
+  const uint16_t coeffs[8] = {0, 46372, 43981, 29059, 27842, 31553, 28165, 0};
+  for (uint8_t i = 0; i < 8; i++) {
+    sensor.sensorCoeffs[i] = coeffs[i];
+  }
+  sensor.prepareCoefficients();
+  lut.build(sensor);
+  sensor.setLUT(&lut);
+  sensor.setConversion(conversion);
+  int32_t check = 0;
+  uint32_t start = cycles();
+  unsigned long startUs = micros();
+  for (uint16_t i = 0; i < CONVERT_CALLS; i++) {
+    sensor.convertRaw(4000000UL + i * 97UL, 8000000UL + i * 211UL);
+    check += sensor.pressureInt();
+  }
+  uint32_t elapsed = cycles() - start;
+  unsigned long elapsedUs = micros() - startUs;
+  report(name, "cycles", (float)elapsed / CONVERT_CALLS);
+  report(name, "us", (float)elapsedUs / CONVERT_CALLS);
+  // Print the checksum so the loop can't be optimised away
+  report(name, "checksum", check);
+}
+
+//-------------------------------------------------
+// Time the array aggregation with 'sensors' simulated sensors, each with a
+// reading every 100 ms, aggregated into 1 s windows with a gradient between
+// each pair of neighbours.
+void benchArray(const char *name, uint16_t sensors) {
+  MS_5803_Array array(sensors, sensors - 1, 1000);
+  for (uint16_t i = 0; i + 1 < sensors; i++) {
+    array.setPair(i, i, i + 1, 1.0);
+  }
+  uint32_t seed = 1;
+  uint32_t windows = 0;
+  unsigned long start = micros();
+  for (uint32_t r = 0; r < ARRAY_READINGS; r++) {
+    for (uint16_t s = 0; s < sensors; s++) {
+      seed = seed * 1664525UL + 1013904223UL;
+      windows += array.add(s, r * 100, 100000 + (int32_t)(seed >> 24) + s);
+    }
+  }
+  windows += array.flush();
+  unsigned long elapsed = micros() - start;
+  report(name, "us_per_reading", (float)elapsed / ((uint32_t)ARRAY_READINGS * sensors));
+  report(name, "windows", windows);
+}
+
+//-------------------------------------------------
+// Compare the vertical speed from the Kalman filters with a moving average
+// of the altitude differenced over its window, for a variometer at 
+// KALMAN_RATE Hz and OSR 4096: level for 30 s, then climbing at 1 m/s. 
+// Reports the RMS speed while level ("noise", m/s), the time to reach 90%
+// of the climb rate ("latency", s) and the time per update.
+void benchKalman() {
+  const char *names[4] = {"kalman", "kalmanAccel", "kalmanFixed", "movingAverage"};
+  MS_5803_Kalman kalman(MS5803_KALMAN_ALTITUDE, 0.5);
+  MS_5803_Kalman kalmanAccel(MS5803_KALMAN_ALTITUDE, 0.5, true);
+  MS_5803_KalmanFixed kalmanFixed(6);
+  float window[MOVING_AVERAGE];
+  float noise = MS_5803::pressureNoise(4096);
+  float sumSquares[4] = {0, 0, 0, 0};
+  float latency[4] = {-1, -1, -1, -1};
+  uint32_t spent[4] = {0, 0, 0, 0};
+  uint16_t level = 0;
+  uint32_t seed = 1;
+  for (uint16_t i = 0; i < 60 * KALMAN_RATE; i++) {
+    uint32_t ms = i * (1000UL / KALMAN_RATE);
+    float t = ms / 1000.0;
+    float altitude = t < 30 ? 0 : t - 30;
+    // Pressure at that altitude with roughly normal noise, rounded to 
+    // 0.01 mbar like pressureInt()
+    float u = 0;
+    for (uint8_t j = 0; j < 4; j++) {
+      seed = seed * 1664525UL + 1013904223UL;
+      u += (seed >> 8) / 16777216.0;
+    }
+    float mbar = 1013.25 * pow(1 - altitude / 44330.8, 5.25588) + (u - 2) * 1.732 * noise;
+    int32_t pressure = lround(mbar * 100);
+    mbar = pressure / 100.0;
+    float k = kalman.slope(mbar);
+    float variance = k * k * noise * noise;
+    float speed[4];
+    uint32_t start = cycles();
+    kalman.update(ms, kalman.toPosition(mbar), variance);
+    speed[0] = kalman.velocity();
+    uint32_t mid = cycles();
+    spent[0] += mid - start;
+    start = mid;
+    kalmanAccel.update(ms, kalmanAccel.toPosition(mbar), variance);
+    speed[1] = kalmanAccel.velocity();
+    mid = cycles();
+    spent[1] += mid - start;
+    start = mid;
+    kalmanFixed.update(ms, pressure, noise);
+    speed[2] = kalmanFixed.rate() / 100.0;
+    mid = cycles();
+    spent[2] += mid - start;
+    start = mid;
+    for (uint8_t j = MOVING_AVERAGE - 1; j > 0; j--) {
+      window[j] = i >= j ? window[j - 1] : kalman.toPosition(mbar);
+    }
+    window[0] = kalman.toPosition(mbar);
+    speed[3] = (window[0] - window[MOVING_AVERAGE - 1]) * KALMAN_RATE / (MOVING_AVERAGE - 1);
+    spent[3] += cycles() - start;
+    // The fixed point filter gives the pressure rate
+    speed[2] *= k;
+    if (t >= 10 && t < 30) {
+      level++;
+      for (uint8_t j = 0; j < 4; j++) {
+        sumSquares[j] += speed[j] * speed[j];
+      }
+    }
+    for (uint8_t j = 0; j < 4 && t >= 30; j++) {
+      if (latency[j] < 0 && speed[j] >= 0.9) {
+        latency[j] = t - 30;
+      }
+    }
+  }
+  for (uint8_t j = 0; j < 4; j++) {
+    report(names[j], "noise", sqrt(sumSquares[j] / level));
+    report(names[j], "latency", latency[j]);
+    report(names[j], "cycles", (float)spent[j] / (60 * KALMAN_RATE));
+  }
+}
+
+//-------------------------------------------------
+// Time the multi-rate stage per reading as outputs are added: a 50 Hz 
+// stream, then 1 Hz, then one a minute.
+void benchMultiRate() {
+  const char *names[3] = {"multiRate1", "multiRate2", "multiRate3"};
+  const uint16_t factors[3] = {1, 50, 60};
+  for (uint8_t outputs = 1; outputs <= 3; outputs++) {
+    MS_5803_MultiRate multi;
+    for (uint8_t i = 0; i < outputs; i++) {
+      multi.addStage(factors[i]);
+    }
+    uint32_t seed = 1;
+    uint32_t check = 0;
+    uint32_t start = cycles();
+    for (uint16_t i = 0; i < MULTIRATE_READINGS; i++) {
+      seed = seed * 1664525UL + 1013904223UL;
+      check += multi.add(101325 + (int32_t)(seed >> 28));
+    }
+    uint32_t elapsed = cycles() - start;
+    report(names[outputs - 1], "cycles", (float)elapsed / MULTIRATE_READINGS);
+    report(names[outputs - 1], "checksum", check);
+  }
+}
+
+//-------------------------------------------------
+// Throughput of resampling readings taken every 0.3 to 1.7 s onto a 1 s 
+// grid, per reading.
+void benchResample(const char *name, uint8_t method) {
+  MS_5803_Resample resample(1000, 5000, method);
+  uint32_t seed = 1;
+  uint32_t ms = 0;
+  uint32_t points = 0;
+  int32_t check = 0;
+  uint32_t start = cycles();
+  for (uint16_t i = 0; i < RESAMPLE_READINGS; i++) {
+    seed = seed * 1664525UL + 1013904223UL;
+    ms += 300 + (seed >> 16) % 1400;
+    resample.add(ms, 101325 + (int32_t)(seed >> 28));
+    while (resample.next()) {
+      check += resample.value();
+      points++;
+    }
+  }
+  uint32_t elapsed = cycles() - start;
+  report(name, "cycles", (float)elapsed / RESAMPLE_READINGS);
+  report(name, "points", points);
+  report(name, "checksum", check);
+}
+
+//-------------------------------------------------
+// A client that takes at most 'rate' bytes each time it is written to, as
+// a slow link would, and throws them away
+class Sink : public Print {
+public:
+  uint16_t rate = 0;
+  uint32_t bytes = 0;
+  int availableForWrite() { return rate; }
+  size_t write(uint8_t) { bytes++; return 1; }
+  size_t write(const uint8_t *, size_t length) { bytes += length; return length; }
+};
+
+//-------------------------------------------------
+// Time publishing readings from 4 sensors to 'count' clients, pumping 
+// after each reading. Clients alternate between fast ones (room for 4 
+// records per pump) and slow ones (room for 1 record every other pump) that
+// fall behind and drop their oldest records.
+void benchPublish(const char *name, uint8_t count) {
+  MS_5803_Publisher publisher;
+  Sink sinks[MS5803_PUBLISH_CLIENTS];
+  for (uint8_t i = 0; i < count; i++) {
+    publisher.subscribe(sinks[i], 16, i % 3 ? 0xFFFFFFFF : 0x3, i % 4 == 2 ? 2 : 1);
+  }
+  uint32_t start = cycles();
+  for (uint16_t i = 0; i < PUBLISH_READINGS; i++) {
+    for (uint8_t j = 0; j < count; j++) {
+      sinks[j].rate = j % 2 ? ((i & 1) ? MS5803_PUBLISH_RECORD : 0) : 4 * MS5803_PUBLISH_RECORD;
+    }
+    publisher.publish(i % 4, i * 10UL, 101325 + (int32_t)(i & 15), 2000);
+    publisher.pump();
+  }
+  uint32_t elapsed = cycles() - start;
+  uint32_t dropped = 0;
+  uint32_t sent = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    dropped += publisher.dropped(i);
+    sent += publisher.sent(i);
+  }
+  report(name, "cycles", (float)elapsed / PUBLISH_READINGS);
+  report(name, "sent", sent);
+  report(name, "dropped", dropped);
+}
+
+//-------------------------------------------------
+// Compare exporting readings from 4 sensors as CSV lines and as an Arrow 
+// stream: time and bytes per reading.
+void benchExport() {
+  Sink csv;
+  csv.rate = 0xFFFF;
+  uint32_t start = cycles();
+  csv.println("ms,sensor,pressure,temperature,d1,d2,flags");
+  for (uint16_t i = 0; i < EXPORT_READINGS; i++) {
+    csv.print(i * 10UL);
+    csv.print(',');
+    csv.print(i % 4);
+    csv.print(',');
+    csv.print(101325L + (int32_t)(i & 15));
+    csv.print(',');
+    csv.print(2000 + (int32_t)(i & 7));
+    csv.print(',');
+    csv.print(4000000UL + i);
+    csv.print(',');
+    csv.print(8000000UL + i);
+    csv.print(',');
+    csv.println(0);
+  }
+  uint32_t elapsed = cycles() - start;
+  report("exportCSV", "cycles", (float)elapsed / EXPORT_READINGS);
+  report("exportCSV", "bytes", (float)csv.bytes / EXPORT_READINGS);
+
+  Sink arrow;
+  arrow.rate = 0xFFFF;
+  MS_5803_ArrowWriter writer(arrow, EXPORT_BATCH);
+  start = cycles();
+  writer.begin();
+  for (uint16_t i = 0; i < EXPORT_READINGS; i++) {
+    writer.add(i * 10UL, i % 4, 101325 + (int32_t)(i & 15), 2000 + (int32_t)(i & 7),
+               4000000UL + i, 8000000UL + i);
+  }
+  writer.end();
+  elapsed = cycles() - start;
+  report("exportArrow", "cycles", (float)elapsed / EXPORT_READINGS);
+  report("exportArrow", "bytes", (float)arrow.bytes / EXPORT_READINGS);
+}
+
+//-------------------------------------------------
+// Run a schedule for 4 simulated sensors through a command list: each tick
+// every sensor finishes one conversion and starts the next, pressure and
+// temperature in turn. Reports the bus transactions and the time per tick;
+// with simulated sensors the time leaves out the bus itself.
+void benchCommandList(const char *name, uint8_t transport) {
+  MS_5803_SignalConfig config;
+  config.intervalMs = 10;
+  MS_5803_SignalGen gens[4] = {MS_5803_SignalGen(config), MS_5803_SignalGen(config),
+                               MS_5803_SignalGen(config), MS_5803_SignalGen(config)};
+  MS_5803 sensors[4] = {MS_5803(512), MS_5803(512), MS_5803(512), MS_5803(512)};
+  MS_5803_CommandList even(8, transport);
+  MS_5803_CommandList odd(8, transport);
+  for (uint8_t i = 0; i < 4; i++) {
+    sensors[i].setSimulator(&gens[i]);
+    sensors[i].initializeMS_5803(false);
+    even.add(sensors[i], MS5803_OP_READ_D2);
+    even.add(sensors[i], MS5803_OP_START_D1);
+    odd.add(sensors[i], MS5803_OP_READ_D1);
+    odd.add(sensors[i], MS5803_OP_START_D2);
+  }
+  uint32_t transactions = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    sensors[i].startTemperature();
+    transactions -= sensors[i].activity().transactions;
+  }
+  uint32_t readings = 0;
+  uint32_t start = cycles();
+  for (uint16_t t = 0; t < SCHEDULE_TICKS; t++) {
+    readings += (t & 1 ? odd : even).submit();
+  }
+  uint32_t elapsed = cycles() - start;
+  for (uint8_t i = 0; i < 4; i++) {
+    transactions += sensors[i].activity().transactions;
+  }
+  report(name, "transactions", (float)transactions / SCHEDULE_TICKS);
+  report(name, "cycles", (float)elapsed / SCHEDULE_TICKS);
+  report(name, "readings", readings);
+}
+
+//-------------------------------------------------
+// A log held in RAM, written as a Print and read back as a block source
+class LogBuffer : public Print, public MS_5803_BlockSource {
+public:
+  LogBuffer(uint32_t capacity) : data(new uint8_t[capacity]), cap(capacity) {}
+  ~LogBuffer() { delete[] data; }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *bytes, size_t length) {
+    length = min((uint32_t)length, cap - used);
+    memcpy(data + used, bytes, length);
+    used += length;
+    return length;
+  }
+  uint32_t size() { return used; }
+  uint16_t read(uint32_t offset, uint8_t *out, uint16_t length) {
+    length = offset < used ? min((uint32_t)length, used - offset) : 0;
+    memcpy(out, data + offset, length);
+    return length;
+  }
+private:
+  uint8_t *data;
+  uint32_t cap;
+  uint32_t used = 0;
+};
+
+//-------------------------------------------------
+// Time "the highest pressure per sensor per day while below 5 C" over an
+// Arrow log of 4 sensors, in a cold spell halfway through 8 days, with and
+// without skipping batches by their statistics. Reports the time per
+// reading in the log, the batches skipped, and whether both give the same
+// groups.
+void benchQuery() {
+  LogBuffer log(QUERY_READINGS * 26UL + 4096);
+  LogBuffer index(QUERY_READINGS / QUERY_BATCH * sizeof(MS_5803_BlockStats) + 64);
+  MS_5803_ArrowWriter writer(log, QUERY_BATCH);
+  writer.setIndex(&index);
+  writer.begin();
+  uint32_t step = 8 * 86400000UL / QUERY_READINGS;
+  for (uint16_t i = 0; i < QUERY_READINGS; i++) {
+    uint32_t ms = i * step;
+    float days = ms / 86400000.0;
+    int32_t temperature = 1200 - 1000 * exp(-(days - 4) * (days - 4)) + 300 * sin(2 * PI * days);
+    writer.add(ms, i % 4, 101325 + (int32_t)(200 * sin(days)) + (int32_t)(i % 7), temperature, 0, 0);
+  }
+  writer.end();
+  const char *names[2] = {"queryFullScan", "querySkipping"};
+  uint32_t checks[2];
+  for (uint8_t skip = 0; skip < 2; skip++) {
+    MS_5803_Query query(QUERY_BATCH, 64);
+    query.whereTemperature(-4000, 499);
+    query.groupBy(86400000UL);
+    query.setSkipping(skip);
+    uint32_t start = cycles();
+    query.scan(log, index);
+    uint32_t elapsed = cycles() - start;
+    checks[skip] = query.matched();
+    for (uint16_t g = 0; g < query.groups(); g++) {
+      checks[skip] = checks[skip] * 31 + query.group(g).max + query.group(g).sensor * 7 + query.group(g).bucket;
+    }
+    report(names[skip], "cycles", (float)elapsed / QUERY_READINGS);
+    report(names[skip], "blocksRead", query.blocksRead());
+    report(names[skip], "blocksSkipped", query.blocksSkipped());
+    report(names[skip], "matched", query.matched());
+    report(names[skip], "groups", query.groups());
+  }
+  report("querySkipping", "sameResults", checks[0] == checks[1]);
+}
+
+void setup() {
+  Serial.begin(9600);
+  delay(2000);
+  benchConvert("convertRaw", MS5803_CONVERT_INTEGER);
+  benchConvert("convertFloat", MS5803_CONVERT_FLOAT);
+  benchConvert("convertLUT", MS5803_CONVERT_LUT);
+  benchArray("array64", 64);
+  benchArray("array256", 256);
+  benchKalman();
+  benchMultiRate();
+  benchResample("resampleLinear", MS5803_RESAMPLE_LINEAR);
+  benchResample("resampleCubic", MS5803_RESAMPLE_CUBIC);
+  benchPublish("publish1", 1);
+  benchPublish("publish4", 4);
+  benchPublish("publish8", 8);
+  benchExport();
+  benchCommandList("scheduleSequential", MS5803_TRANSPORT_SEQUENTIAL);
+  benchCommandList("scheduleBatched", MS5803_TRANSPORT_BATCHED);
+  benchQuery();
+}
+
+void loop() {
+}
@@ -0,0 +1,172 @@
+/* MS5803_05_bus.ino
+  Measures the worst-case wait for a shared I2C bus (MS5803_Bus.h) in each
+  priority class. No sensor is needed: a simulated sensor
+  (MS5803_SignalGen.h) is read through the arbiter while two simulated
+  clients keep the bus busy, an RTC that holds it for RTC_HOLD us every
+  RTC_PERIOD us at normal priority, and a display that sends frames in
+  chunks of DISPLAY_HOLD us, DISPLAY_GAP us apart, at bulk priority.
+
+  The sensor is read BUS_READINGS times at each priority in turn. Results
+  are printed to the Serial terminal as one JSON object per line, e.g.
+    {"bench":"busCritical","metric":"maxWait","value":2004}
+  with the waits in us, then PASS or FAIL. It passes if no critical read
+  timed out or waited for more than the hold it arrived in.
+
+  On the ESP32 the clients run in a FreeRTOS task of their own, as they
+  would in an application, and a waiting read sleeps a tick at a time.
+  There a critical read must not wait longer than the longest hold plus
+  BUS_SLACK. Elsewhere the clients run from yield(), which the arbiter
+  calls while it waits, so the sketch also counts the holds that started
+  while the sensor waited ("overtaken"); a critical read must see none.
+  Its waits are then only as precise as micros(), e.g. a host build
+  reports the stalls of its own scheduler.
+*/
+
+#include <MS5803_05.h>
+#include <MS5803_SignalGen.h>
+#include <MS5803_Bus.h>
+
+// Readings per priority, and the time between them in us
+#define BUS_READINGS 500
+#define BUS_INTERVAL 3000
+// Timeout of the sensor's waits, us
+#define BUS_TIMEOUT 20000
+// The other clients' holds and the time between them, us
+#define RTC_HOLD 300
+#define RTC_PERIOD 7000
+#define DISPLAY_HOLD 2000
+#define DISPLAY_GAP 50
+// Largest wait accepted over the longest hold on the ESP32, us
+#define BUS_SLACK (portTICK_PERIOD_MS * 1000UL + 500)
+
+// A client that takes the bus when it is due and holds it for holdUs
+struct Client {
+  uint8_t priority;
+  uint32_t holdUs;
+  uint32_t gapUs;
+  boolean holding;
+  unsigned long since;
+};
+
+MS_5803 sensor = MS_5803(512);
+MS_5803_BusArbiter bus;
+Client rtc = {MS5803_PRIORITY_NORMAL, RTC_HOLD, RTC_PERIOD - RTC_HOLD, false, 0};
+Client display = {MS5803_PRIORITY_BULK, DISPLAY_HOLD, DISPLAY_GAP, false, 0};
+boolean pass = true;
+// Holds that started while the sensor waited, see yield()
+uint32_t overtaken = 0;
+boolean pausing = false;
+
+//-------------------------------------------------
+// Print one result as a line of JSON
+void report(const char *bench, const char *metric, float value) {
+  Serial.print("{\"bench\":\"");
+  Serial.print(bench);
+  Serial.print("\",\"metric\":\"");
+  Serial.print(metric);
+  Serial.print("\",\"value\":");
+  Serial.print(value, 0);
+  Serial.println("}");
+}
+
+//-------------------------------------------------
+// Release the bus once the hold is over, or try to take it once the gap
+// is over. A try that fails is counted as a timeout of the client's class.
+// Returns true if the client took the bus.
+boolean step(Client &client) {
+  unsigned long now = micros();
+  if (client.holding) {
+    if (now - client.since >= client.holdUs) {
+      client.holding = false;
+      client.since = now;
+      bus.release();
+    }
+  } else if (now - client.since >= client.gapUs && bus.acquire(client.priority, 0)) {
+    client.holding = true;
+    client.since = now;
+    return true;
+  }
+  return false;
+}
+
+#if defined(ESP32)
+void clients(void *) {
+  for (;;) {
+    step(rtc);
+    step(display);
+  }
+}
+
+// Sleep until the next reading; the clients' task runs meanwhile
+void pause() {
+  vTaskDelay(1);
+}
+#else
+// Called by the arbiter while the sensor waits, and by pause()
+void yield() {
+  boolean taken = step(rtc);
+  taken = step(display) || taken;
+  if (taken && !pausing) {
+    overtaken++;
+  }
+}
+
+// Run the clients until the next reading
+void pause() {
+  unsigned long start = micros();
+  pausing = true;
+  while (micros() - start < BUS_INTERVAL) {
+    yield();
+  }
+  pausing = false;
+}
+#endif
+
+//-------------------------------------------------
+// Read the sensor at 'priority' and report its longest wait and timeouts
+void run(const char *name, uint8_t priority) {
+  sensor.setArbiter(&bus, priority, BUS_TIMEOUT);
+  sensor.resetActivity();
+  bus.resetStats();
+  overtaken = 0;
+  for (uint16_t i = 0; i < BUS_READINGS; i++) {
+    pause();
+    sensor.readSensor();
+  }
+  // The clients' waits are never longer than one try, so the longest wait
+  // of the class is the sensor's
+  uint32_t maxWait = bus.maxWaitMicros(priority);
+  report(name, "maxWait", maxWait);
+  report(name, "timeouts", sensor.activity().busTimeouts);
+#if defined(ESP32)
+  boolean ok = maxWait <= max(RTC_HOLD, DISPLAY_HOLD) + BUS_SLACK;
+#else
+  report(name, "overtaken", overtaken);
+  boolean ok = overtaken == 0;
+#endif
+  if (priority == MS5803_PRIORITY_CRITICAL) {
+    pass = ok && sensor.activity().busTimeouts == 0;
+  }
+}
+
+void setup() {
+  Serial.begin(9600);
+  delay(2000);
+  MS_5803_SignalConfig config;
+  config.intervalMs = 10;
+  MS_5803_SignalGen generator = MS_5803_SignalGen(config);
+  sensor.setSimulator(&generator);
+  sensor.initializeMS_5803(false);
+#if defined(ESP32)
+  // On the loop's core, so that its waits are what let the clients run
+  xTaskCreatePinnedToCore(clients, "clients", 2048, NULL, 1, NULL, xPortGetCoreID());
+#endif
+  run("busCritical", MS5803_PRIORITY_CRITICAL);
+  run("busHigh", MS5803_PRIORITY_HIGH);
+  run("busNormal", MS5803_PRIORITY_NORMAL);
+  run("busBulk", MS5803_PRIORITY_BULK);
+  Serial.println(pass ? "PASS" : "FAIL");
+}
+
+void loop() {
+}
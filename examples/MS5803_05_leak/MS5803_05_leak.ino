@@ -0,0 +1,91 @@
+/* MS5803_05_leak.ino
+  Tests the leak rate fit (MS5803_Leak.h) on a simulated sealed housing.
+  No sensor is needed: the signal generator (MS5803_SignalGen.h) simulates
+  a housing at 20 C on average, with a daily temperature cycle of +-8 C
+  seen through the sensor's thermal lag, that loses LEAK_RATE mbar per
+  hour. A reading is taken every 10 minutes.
+
+  For records of 1 day to a year of virtual time, the fitted rate is
+  compared with the simulated one. Results are printed to the Serial
+  terminal as one JSON object per line, e.g.
+    {"bench":"leak30","metric":"rate","value":-0.01000}
+  with the rates in mbar per hour, then PASS or FAIL. It passes if the
+  rate fitted to each record of a week or more is within LEAK_TOLERANCE
+  of the simulated one. A single day is only reported: the compensation
+  leaves a few hundredths of a mbar of the temperature cycle in the
+  normalised pressure, which over one cycle biases the rate by about a
+  third.
+*/
+
+#include <MS5803_05.h>
+#include <MS5803_SignalGen.h>
+#include <MS5803_Leak.h>
+
+// Simulated leak, mbar per hour at 20 C
+#define LEAK_RATE 0.01
+// Time between readings, s
+#define LEAK_INTERVAL 600
+// Largest error accepted, relative to LEAK_RATE
+#define LEAK_TOLERANCE 0.05
+
+MS_5803 sensor = MS_5803(4096);
+boolean pass = true;
+
+//-------------------------------------------------
+// Print one result as a line of JSON
+void report(const char *bench, const char *metric, float value) {
+  Serial.print("{\"bench\":\"");
+  Serial.print(bench);
+  Serial.print("\",\"metric\":\"");
+  Serial.print(metric);
+  Serial.print("\",\"value\":");
+  Serial.print(value, 5);
+  Serial.println("}");
+}
+
+//-------------------------------------------------
+// Fit the leak over 'days' of readings and check the rate
+void run(const char *name, uint16_t days) {
+  MS_5803_SignalConfig config;
+  config.intervalMs = LEAK_INTERVAL * 1000UL;
+  config.sealed = true;
+  config.leakRate = LEAK_RATE;
+  config.temperature = 20;
+  config.dailyTemperature = 8;
+  // Spikes and dropouts are left out; the fit's robustness to them is
+  // not what is measured here
+  config.spikeRate = 0;
+  config.dropoutRate = 0;
+  MS_5803_SignalGen generator = MS_5803_SignalGen(config);
+  sensor.setSimulator(&generator);
+  sensor.initializeMS_5803(false);
+  MS_5803_Leak leak = MS_5803_Leak(0);
+  uint32_t readings = (uint32_t)days * 86400UL / LEAK_INTERVAL;
+  for (uint32_t i = 0; i < readings; i++) {
+    sensor.readSensor();
+    leak.add(sensor, generator.time() / 1000);
+  }
+  float error = fabs(leak.rate() + LEAK_RATE);
+  report(name, "days", days);
+  report(name, "rate", leak.rate());
+  report(name, "rateError", leak.rateError());
+  if (days >= 7) {
+    boolean ok = error <= LEAK_TOLERANCE * LEAK_RATE;
+    report(name, "ok", ok);
+    pass = pass && ok;
+  }
+}
+
+void setup() {
+  Serial.begin(9600);
+  delay(2000);
+  run("leak1", 1);
+  run("leak7", 7);
+  run("leak30", 30);
+  run("leak90", 90);
+  run("leak365", 365);
+  Serial.println(pass ? "PASS" : "FAIL");
+}
+
+void loop() {
+}
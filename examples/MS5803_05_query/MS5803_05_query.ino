@@ -0,0 +1,161 @@
+/* MS5803_05_query.ino
+  Checks log queries (MS5803_Query.h) against a brute force computation.
+  No sensor is needed: QUERY_READINGS readings of 5 simulated sensors over
+  QUERY_DAYS days, with a cold spell halfway through, are written to an
+  Arrow log and index in RAM (MS5803_Arrow.h). While they are written, the
+  count, minimum, maximum and sum of the pressure per sensor per day below
+  5 C, leaving out sensor 3, are worked out reading by reading.
+
+  The same query is then run over the log with and without skipping
+  batches by their statistics. Results are printed to the Serial terminal
+  as one JSON object per line, e.g.
+    {"bench":"querySkipping","metric":"blocksRead","value":4}
+  with the times in us, then PASS or FAIL. It passes if both give exactly
+  the groups worked out by brute force.
+
+  Needs about 26 bytes of RAM per reading, about 100 KB by default (e.g. an
+  ESP32). For a larger check, build it for the host with QUERY_READINGS
+  400000 and QUERY_BATCH 1024: 36 of 391 batches are read.
+*/
+
+#include <MS5803_Arrow.h>
+#include <MS5803_Query.h>
+
+// Readings in the log, days they cover, and rows per batch
+#define QUERY_READINGS 4000
+#define QUERY_DAYS 28
+#define QUERY_BATCH 128
+// Sensors, and the one the query leaves out
+#define QUERY_SENSORS 5
+#define QUERY_EXCLUDED 3
+// Temperatures below this match, 0.01 C
+#define QUERY_BELOW 500
+
+// Brute force groups, per sensor per day
+uint32_t refCount[QUERY_SENSORS][QUERY_DAYS];
+int32_t refMin[QUERY_SENSORS][QUERY_DAYS];
+int32_t refMax[QUERY_SENSORS][QUERY_DAYS];
+int64_t refSum[QUERY_SENSORS][QUERY_DAYS];
+uint32_t seed = 1;
+
+//-------------------------------------------------
+// Print one result as a line of JSON
+void report(const char *bench, const char *metric, float value) {
+  Serial.print("{\"bench\":\"");
+  Serial.print(bench);
+  Serial.print("\",\"metric\":\"");
+  Serial.print(metric);
+  Serial.print("\",\"value\":");
+  Serial.print(value, 0);
+  Serial.println("}");
+}
+
+//-------------------------------------------------
+// A log held in RAM, written as a Print and read back as a block source
+class LogBuffer : public Print, public MS_5803_BlockSource {
+public:
+  LogBuffer(uint32_t capacity) : data(new uint8_t[capacity]), cap(capacity) {}
+  ~LogBuffer() { delete[] data; }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *bytes, size_t length) {
+    length = min((uint32_t)length, cap - used);
+    memcpy(data + used, bytes, length);
+    used += length;
+    return length;
+  }
+  uint32_t size() { return used; }
+  uint16_t read(uint32_t offset, uint8_t *out, uint16_t length) {
+    length = offset < used ? min((uint32_t)length, used - offset) : 0;
+    memcpy(out, data + offset, length);
+    return length;
+  }
+private:
+  uint8_t *data;
+  uint32_t cap;
+  uint32_t used = 0;
+};
+
+//-------------------------------------------------
+// Write the log, and the brute force groups of the readings that match
+void fill(LogBuffer &log, LogBuffer &index) {
+  MS_5803_ArrowWriter writer(log, QUERY_BATCH);
+  writer.setIndex(&index);
+  writer.begin();
+  uint32_t step = QUERY_DAYS * 86400000UL / QUERY_READINGS;
+  for (uint32_t i = 0; i < QUERY_READINGS; i++) {
+    seed = seed * 1664525UL + 1013904223UL;
+    uint32_t ms = i * step;
+    float days = ms / 86400000.0;
+    float cold = days - QUERY_DAYS / 2;
+    int32_t temperature = 1200 - 1000 * exp(-cold * cold / 4) + 300 * sin(2 * PI * days)
+                          + (int32_t)(seed >> 28);
+    int32_t pressure = 101325 + (int32_t)((seed >> 20) % 500);
+    uint8_t sensor = seed % QUERY_SENSORS;
+    writer.add(ms, sensor, pressure, temperature, 0, 0);
+    if (temperature >= QUERY_BELOW || sensor == QUERY_EXCLUDED) {
+      continue;
+    }
+    uint16_t day = ms / 86400000UL;
+    if (refCount[sensor][day] == 0) {
+      refMin[sensor][day] = refMax[sensor][day] = pressure;
+    }
+    refMin[sensor][day] = min(refMin[sensor][day], pressure);
+    refMax[sensor][day] = max(refMax[sensor][day], pressure);
+    refSum[sensor][day] += pressure;
+    refCount[sensor][day]++;
+  }
+  writer.end();
+}
+
+//-------------------------------------------------
+// Run the query and compare its groups with the brute force ones. Returns
+// true if they are the same.
+boolean run(const char *name, boolean skipping, LogBuffer &log, LogBuffer &index) {
+  MS_5803_Query query(QUERY_BATCH, QUERY_SENSORS * QUERY_DAYS);
+  query.whereTemperature(-4000, QUERY_BELOW - 1);
+  query.whereSensors(~((uint32_t)1 << QUERY_EXCLUDED));
+  query.groupBy(86400000UL);
+  query.setSkipping(skipping);
+  unsigned long start = micros();
+  boolean ok = query.scan(log, index);
+  unsigned long elapsed = micros() - start;
+
+  uint32_t expected = 0;
+  for (uint8_t s = 0; s < QUERY_SENSORS; s++) {
+    for (uint16_t d = 0; d < QUERY_DAYS; d++) {
+      expected += refCount[s][d] ? 1 : 0;
+    }
+  }
+  uint32_t mismatches = 0;
+  for (uint16_t i = 0; i < query.groups(); i++) {
+    const MS_5803_QueryGroup &g = query.group(i);
+    if (g.sensor >= QUERY_SENSORS || g.bucket >= QUERY_DAYS
+        || g.count != refCount[g.sensor][g.bucket] || g.min != refMin[g.sensor][g.bucket]
+        || g.max != refMax[g.sensor][g.bucket] || g.sum != refSum[g.sensor][g.bucket]) {
+      mismatches++;
+    }
+  }
+  report(name, "time", elapsed);
+  report(name, "blocksRead", query.blocksRead());
+  report(name, "blocksSkipped", query.blocksSkipped());
+  report(name, "matched", query.matched());
+  report(name, "groups", query.groups());
+  report(name, "expectedGroups", expected);
+  report(name, "mismatches", mismatches);
+  return ok && mismatches == 0 && query.groups() == expected;
+}
+
+void setup() {
+  Serial.begin(9600);
+  delay(2000);
+  LogBuffer log(QUERY_READINGS * 26UL + 4096);
+  LogBuffer index((QUERY_READINGS / QUERY_BATCH + 1) * sizeof(MS_5803_BlockStats));
+  fill(log, index);
+  report("query", "readings", QUERY_READINGS);
+  boolean pass = run("queryFullScan", false, log, index);
+  pass = run("querySkipping", true, log, index) && pass;
+  Serial.println(pass ? "PASS" : "FAIL");
+}
+
+void loop() {
+}
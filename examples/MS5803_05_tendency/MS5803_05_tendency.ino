@@ -0,0 +1,128 @@
+/* MS5803_05_tendency.ino
+  Tests the pressure tendency (MS5803_Tendency.h) on months of simulated
+  weather. No sensor is needed: a simulated sensor (MS5803_SignalGen.h)
+  with a reading a minute and a weather front every 12 hours is read for
+  TENDENCY_DAYS days of virtual time, and each reading is added to the
+  tendency.
+
+  Whenever a 10 minute slot closes, the tendency's 3 hour change is
+  compared with the change of the generator's true pressure, averaged
+  over the same slots, and its alerts with the true change. Results are
+  printed to the Serial terminal as one JSON object per line, e.g.
+    {"bench":"tendency","metric":"maxError","value":0.041}
+  with the errors in mbar, then PASS or FAIL. It passes if the change is
+  always within TENDENCY_TOLERANCE, the characteristic is known once there
+  are 3 hours of history, and every change past the alert threshold (and
+  none below where it clears) raised an alert.
+*/
+
+#include <MS5803_05.h>
+#include <MS5803_SignalGen.h>
+#include <MS5803_Tendency.h>
+
+// Virtual time covered, and time between readings
+#define TENDENCY_DAYS 120
+#define TENDENCY_INTERVAL 60
+// Largest error accepted in the 3 hour change, 0.01 mbar
+#define TENDENCY_TOLERANCE 30
+// Alert threshold, 0.01 mbar in 3 hours
+#define TENDENCY_ALERT 360
+// Slots in 3 hours
+#define SLOTS_3H (3 * 3600 / MS5803_TENDENCY_SLOT)
+
+MS_5803 sensor = MS_5803(4096);
+MS_5803_Tendency tendency = MS_5803_Tendency(TENDENCY_ALERT);
+// True slot means, 0.01 mbar, the latest at trueHead
+float trueSlots[SLOTS_3H + 1];
+uint8_t trueHead = 0;
+
+//-------------------------------------------------
+// Print one result as a line of JSON
+void report(const char *bench, const char *metric, float value) {
+  Serial.print("{\"bench\":\"");
+  Serial.print(bench);
+  Serial.print("\",\"metric\":\"");
+  Serial.print(metric);
+  Serial.print("\",\"value\":");
+  Serial.print(value, 3);
+  Serial.println("}");
+}
+
+void setup() {
+  Serial.begin(9600);
+  delay(2000);
+  MS_5803_SignalConfig config;
+  config.intervalMs = TENDENCY_INTERVAL * 1000UL;
+  config.frontHours = 12;
+  config.frontAmplitude = 15;
+  // Spikes and dropouts are the job of the outlier filters, not this test
+  config.spikeRate = 0;
+  config.dropoutRate = 0;
+  MS_5803_SignalGen generator = MS_5803_SignalGen(config);
+  sensor.setSimulator(&generator);
+  sensor.initializeMS_5803(false);
+
+  uint32_t readings = (uint32_t)TENDENCY_DAYS * 86400UL / TENDENCY_INTERVAL;
+  uint32_t slot = 0;
+  float trueSum = 0;
+  uint16_t trueCount = 0;
+  uint32_t slotsClosed = 0;
+  uint32_t checks = 0;
+  uint32_t unknown = 0;
+  uint32_t missed = 0;
+  uint32_t falseAlerts = 0;
+  uint32_t raised = 0;
+  float maxError = 0;
+  float sumSquares = 0;
+  for (uint32_t i = 0; i < readings; i++) {
+    sensor.readSensor();
+    uint32_t seconds = generator.time() / 1000;
+    uint32_t number = seconds / MS5803_TENDENCY_SLOT;
+    if (i > 0 && number != slot) {
+      trueHead = (trueHead + 1) % (SLOTS_3H + 1);
+      trueSlots[trueHead] = trueSum / trueCount;
+      slotsClosed++;
+      trueSum = 0;
+      trueCount = 0;
+    }
+    slot = number;
+    trueSum += generator.truePressure() * 100;
+    trueCount++;
+    raised += tendency.add(seconds, sensor.pressureInt()) ? 1 : 0;
+    // Check each slot once it has closed, with 3 hours of history
+    if (trueCount != 1 || slotsClosed <= SLOTS_3H) {
+      continue;
+    }
+    checks++;
+    if (tendency.characteristic() == MS5803_TENDENCY_UNKNOWN) {
+      unknown++;
+      continue;
+    }
+    float truth = trueSlots[trueHead] - trueSlots[(trueHead + 1) % (SLOTS_3H + 1)];
+    float error = fabs(tendency.change(3) - truth);
+    maxError = max(maxError, error);
+    sumSquares += error * error;
+    uint8_t alerts = tendency.alerts();
+    if ((truth >= TENDENCY_ALERT + TENDENCY_TOLERANCE && !(alerts & MS5803_TENDENCY_RISING))
+        || (-truth >= TENDENCY_ALERT + TENDENCY_TOLERANCE && !(alerts & MS5803_TENDENCY_FALLING))) {
+      missed++;
+    }
+    if (alerts && fabs(truth) < TENDENCY_ALERT * 3 / 4 - TENDENCY_TOLERANCE) {
+      falseAlerts++;
+    }
+  }
+  report("tendency", "days", TENDENCY_DAYS);
+  report("tendency", "checks", checks);
+  report("tendency", "maxError", maxError / 100);
+  report("tendency", "rmsError", checks ? sqrt(sumSquares / checks) / 100 : 0);
+  report("tendency", "alertsRaised", raised);
+  report("tendency", "missedAlerts", missed);
+  report("tendency", "falseAlerts", falseAlerts);
+  report("tendency", "unknown", unknown);
+  boolean pass = checks > 0 && maxError <= TENDENCY_TOLERANCE && unknown == 0
+                 && missed == 0 && falseAlerts == 0 && raised > 0;
+  Serial.println(pass ? "PASS" : "FAIL");
+}
+
+void loop() {
+}
@@ -0,0 +1,224 @@
+/* MS5803_05_transfer.ino
+  Tests the resumable log transfer (MS5803_Transfer.h) against an emulated
+  lossy, delayed link, with the node and the gateway both running on this
+  board. No sensor is needed: the log is made of simulated binary reading
+  records (ms, D1, D2) as used by MS5803_Replay.h.
+
+  For each loss rate the transfer runs in virtual time on a 115200 baud 
+  link with 50 ms latency each way, where frames are lost (and some 
+  damaged) at random. Results are printed to the Serial terminal as one 
+  JSON object per line, e.g.
+    {"bench":"loss5","metric":"goodput","value":1543.210}
+  with the goodput in log bytes per second. A last run cuts the link for
+  3 s halfway through and restarts the node, to check that the transfer 
+  resumes where it was instead of starting over.
+
+  Needs about 20 KB of RAM (e.g. an ESP32); lower LOG_RECORDS and 
+  LINK_PACKETS on smaller boards.
+*/
+
+#include <MS5803_Transfer.h>
+
+// Readings in the log, 12 bytes each
+#define LOG_RECORDS 500
+// Frames the emulated link can hold in each direction
+#define LINK_PACKETS 64
+#define LINK_PACKET_SIZE 80
+// Link speed in bytes per ms (115200 baud) and latency in ms
+#define LINK_RATE 11
+#define LINK_DELAY 50
+// Give up after this much virtual time, ms
+#define RUN_LIMIT 600000UL
+
+uint8_t logData[LOG_RECORDS * 12];
+// Virtual time in ms
+uint32_t now = 0;
+uint32_t seed = 1;
+
+float random01() {
+  seed = seed * 1664525UL + 1013904223UL;
+  return (seed >> 8) / 16777216.0;
+}
+
+//-------------------------------------------------
+// One direction of the emulated link. Each write() is one frame, which is
+// lost or has a byte damaged at random, and otherwise arrives after the 
+// time to send it and the latency.
+class Pipe {
+public:
+  float loss = 0;
+  boolean up = true;
+  uint32_t dropped = 0;
+
+  void reset() {
+    head = tail = used = 0;
+    offset = 0;
+    busyUntil = 0;
+    dropped = 0;
+  }
+  void push(const uint8_t *data, size_t length) {
+    if (!up || used == LINK_PACKETS || length > LINK_PACKET_SIZE || random01() < loss) {
+      dropped++;
+      return;
+    }
+    memcpy(packets[tail], data, length);
+    if (random01() < loss / 4) {
+      packets[tail][(size_t)(random01() * length)] ^= 0x10;
+    }
+    lengths[tail] = length;
+    busyUntil = max(busyUntil, now) + (length + LINK_RATE - 1) / LINK_RATE;
+    due[tail] = busyUntil + LINK_DELAY;
+    tail = (tail + 1) % LINK_PACKETS;
+    used++;
+  }
+  int available() {
+    if (used == 0 || (int32_t)(due[head] - now) > 0) {
+      return 0;
+    }
+    return lengths[head] - offset;
+  }
+  int read() {
+    if (available() <= 0) {
+      return -1;
+    }
+    int c = packets[head][offset++];
+    if (offset == lengths[head]) {
+      offset = 0;
+      head = (head + 1) % LINK_PACKETS;
+      used--;
+    }
+    return c;
+  }
+
+private:
+  uint8_t packets[LINK_PACKETS][LINK_PACKET_SIZE];
+  uint16_t lengths[LINK_PACKETS];
+  uint32_t due[LINK_PACKETS];
+  uint16_t head, tail, used, offset;
+  uint32_t busyUntil;
+};
+
+// One end of the link, as a Stream
+class LinkEnd : public Stream {
+public:
+  LinkEnd(Pipe &in, Pipe &out) : _in(in), _out(out) {}
+  int available() { return _in.available(); }
+  int read() { return _in.read(); }
+  int peek() { return -1; }
+  size_t write(uint8_t c) { _out.push(&c, 1); return 1; }
+  size_t write(const uint8_t *data, size_t length) { _out.push(data, length); return length; }
+private:
+  Pipe &_in;
+  Pipe &_out;
+};
+
+// Where the gateway writes the log: counts it and keeps its CRC
+class Checker : public Print {
+public:
+  uint32_t bytes = 0;
+  uint16_t crc = 0xFFFF;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t length) {
+    crc = MS_5803_Transfer::crc16(data, length, crc);
+    bytes += length;
+    return length;
+  }
+};
+
+Pipe toGateway;
+Pipe toNode;
+LinkEnd nodeEnd(toNode, toGateway);
+LinkEnd gatewayEnd(toGateway, toNode);
+
+//-------------------------------------------------
+// Print one result as a line of JSON
+void report(const char *bench, const char *metric, float value) {
+  Serial.print("{\"bench\":\"");
+  Serial.print(bench);
+  Serial.print("\",\"metric\":\"");
+  Serial.print(metric);
+  Serial.print("\",\"value\":");
+  Serial.print(value, 3);
+  Serial.println("}");
+}
+
+//-------------------------------------------------
+// Transfer the log with the given loss rate. With 'interrupt', the link 
+// goes down for 3 s halfway and the node restarts.
+void run(const char *name, float loss, boolean interrupt) {
+  MS_5803_MemorySource source(logData, sizeof(logData));
+  Checker checker;
+  MS_5803_TransferReceiver gateway(gatewayEnd, checker, 64, 8);
+  MS_5803_TransferSender *node = new MS_5803_TransferSender(nodeEnd, source, 1, 64, 8);
+  toGateway.reset();
+  toNode.reset();
+  toGateway.loss = toNode.loss = loss;
+  uint32_t start = now;
+  uint32_t frames = 0;
+  uint32_t resent = 0;
+  uint32_t resumedAt = 0;
+  boolean cut = false;
+  while (now - start < RUN_LIMIT) {
+    now++;
+    boolean sent = node->poll(now);
+    boolean received = gateway.poll(now);
+    if (sent && received) {
+      break;
+    }
+    if (interrupt && !cut && node->acknowledged() >= node->totalBlocks() / 2) {
+      // Link down for 3 s, and the node restarts with no memory of the
+      // transfer
+      cut = true;
+      toGateway.up = toNode.up = false;
+      frames += node->framesSent();
+      resent += node->retransmissions();
+      delete node;
+      for (uint16_t i = 0; i < 3000; i++) {
+        now++;
+        gateway.poll(now);
+      }
+      toGateway.up = toNode.up = true;
+      node = new MS_5803_TransferSender(nodeEnd, source, 1, 64, 8);
+      resumedAt = gateway.delivered();
+    }
+  }
+  float seconds = (now - start) / 1000.0;
+  frames += node->framesSent();
+  resent += node->retransmissions();
+  report(name, "goodput", checker.bytes / seconds);
+  report(name, "seconds", seconds);
+  report(name, "frames", frames);
+  report(name, "retransmissions", resent);
+  report(name, "badFrames", gateway.badFrames() + node->badFrames());
+  report(name, "complete", checker.bytes == sizeof(logData)
+         && checker.crc == MS_5803_Transfer::crc16(logData, sizeof(logData)));
+  if (interrupt) {
+    report(name, "resumedAtBlock", resumedAt);
+  }
+  delete node;
+}
+
+void setup() {
+  Serial.begin(9600);
+  delay(2000);
+  // Simulated readings: ms, D1, D2, little-endian
+  for (uint16_t i = 0; i < LOG_RECORDS; i++) {
+    uint32_t fields[3] = {(uint32_t)(i * 1000UL), (uint32_t)(4000000UL + i * 7),
+                          (uint32_t)(8000000UL + i * 3)};
+    for (uint8_t f = 0; f < 3; f++) {
+      for (uint8_t b = 0; b < 4; b++) {
+        logData[i * 12 + f * 4 + b] = fields[f] >> (8 * b);
+      }
+    }
+  }
+  run("loss0", 0, false);
+  run("loss1", 0.01, false);
+  run("loss5", 0.05, false);
+  run("loss10", 0.1, false);
+  run("loss20", 0.2, false);
+  run("loss30", 0.3, false);
+  run("resume", 0.05, true);
+}
+
+void loop() {
+}
@@ -0,0 +1,170 @@
+/* MS5803_05_verify.ino
+  Checks convertRaw() against the compensation from the MS5803 data sheet,
+  computed here in plain 64-bit integer math. On 8-bit AVRs this checks the
+  int64-free path (MS5803_INT64_FREE); elsewhere, build with
+  MS5803_INT64_FREE defined as 1 to check it, or 0 for the 64-bit path.
+  The lookup table path (MS5803_CONVERT_LUT) is checked the same way. The
+  float path (MS5803_CONVERT_FLOAT) is checked against the bound it
+  documents, 2 (0.01 mbar) on the pressure and 1 (0.01 C) on the
+  temperature, over the range it documents, -40 to 85 C and 0 to 6 bar.
+  No sensor is needed.
+
+  For each coefficient set (the data sheet example, extremes and random
+  ones), every VERIFY_D2_STEP'th D2 value is converted with four D1 values
+  (0, full scale, D2 and a random one). Both paths are only defined while
+  the second order terms fit in 32 bits, i.e. for a first order
+  temperature above -150 C, which covers the sensor's -40 to 85 C range;
+  readings below that are skipped and counted.
+
+  Results are printed to the Serial terminal as one JSON object per line,
+  e.g.
+    {"bench":"verify","metric":"mismatches","value":0.000}
+  The default step takes a few minutes on an Uno. Set VERIFY_D2_STEP to 1
+  for every D2 value (872M readings, for a fast board or a host build).
+*/
+
+#include <MS5803_05.h>
+#include <MS5803_LUT.h>
+
+#ifndef VERIFY_D2_STEP
+#define VERIFY_D2_STEP 4099UL
+#endif
+#define VERIFY_SETS 13
+// Lowest first order temperature checked, 0.01 C
+#define VERIFY_MIN_TEMP -15000
+// Range and largest errors of the float path, 0.01 C and 0.01 mbar
+#define FLOAT_MIN_TEMP -4000
+#define FLOAT_MAX_TEMP 8500
+#define FLOAT_MAX_PRESSURE 600000
+#define FLOAT_TEMP_ERROR 1
+#define FLOAT_PRESSURE_ERROR 2
+
+MS_5803 sensor = MS_5803(512);
+MS_5803_LUT lut(2048);
+uint32_t seed = 1;
+
+uint32_t random32() {
+  seed = seed * 1664525UL + 1013904223UL;
+  return seed;
+}
+
+//-------------------------------------------------
+// Print one result as a line of JSON
+void report(const char *bench, const char *metric, float value) {
+  Serial.print("{\"bench\":\"");
+  Serial.print(bench);
+  Serial.print("\",\"metric\":\"");
+  Serial.print(metric);
+  Serial.print("\",\"value\":");
+  Serial.print(value, 3);
+  Serial.println("}");
+}
+
+//-------------------------------------------------
+// Compensation from pages 8 and 9 of the data sheet. Returns false if the
+// first order temperature is below VERIFY_MIN_TEMP.
+boolean reference(const uint16_t *c, uint32_t d1, uint32_t d2,
+                  int32_t &temp, int32_t &pressure) {
+  int64_t dT = (int64_t)d2 - (int64_t)c[5] * 256;
+  int64_t t = 2000 + dT * c[6] / 8388608;
+  if (t < VERIFY_MIN_TEMP) {
+    return false;
+  }
+  int64_t t2 = 0;
+  int64_t off2 = 0;
+  int64_t sens2 = 0;
+  if (t < 2000) {
+    t2 = 3 * dT * dT / 8589934592LL;
+    off2 = 3 * (t - 2000) * (t - 2000) / 8;
+    sens2 = 7 * (t - 2000) * (t - 2000) / 8;
+  }
+  int64_t off = (int64_t)c[2] * 262144 + (int64_t)c[4] * dT / 32 - off2;
+  int64_t sens = (int64_t)c[1] * 131072 + (int64_t)c[3] * dT / 128 - sens2;
+  temp = (int32_t)(t - t2);
+  pressure = (int32_t)(((int64_t)d1 * sens / 2097152 - off) / 32768);
+  return true;
+}
+
+void setup() {
+  Serial.begin(9600);
+  delay(2000);
+  const uint16_t sets[5][8] = {
+    {0, 46372, 43981, 29059, 27842, 31553, 28165, 0},
+    {0, 65535, 65535, 65535, 65535, 65535, 65535, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 65535, 0, 65535, 0, 0, 65535, 0},
+    {0, 0, 65535, 0, 65535, 65535, 65535, 0}};
+  report("verify", "int64Free", MS5803_INT64_FREE);
+  sensor.setCalibration(0, 0);
+  uint32_t checked = 0;
+  uint32_t skipped = 0;
+  uint32_t mismatches = 0;
+  uint32_t lutMismatches = 0;
+  uint32_t floatChecked = 0;
+  uint32_t floatMismatches = 0;
+  int32_t floatTempError = 0;
+  int32_t floatPressureError = 0;
+  sensor.setLUT(&lut);
+  for (uint8_t set = 0; set < VERIFY_SETS; set++) {
+    for (uint8_t i = 0; i < 8; i++) {
+      sensor.sensorCoeffs[i] = set < 5 ? sets[set][i] : (i > 0 && i < 7 ? random32() >> 16 : 0);
+    }
+    lut.build(sensor);
+    sensor.prepareCoefficients();
+    for (uint32_t d2 = 0; d2 < 0x1000000UL; d2 += VERIFY_D2_STEP) {
+      uint32_t d1s[4] = {0, 0xFFFFFF, d2, random32() >> 8};
+      for (uint8_t k = 0; k < 4; k++) {
+        int32_t temp;
+        int32_t pressure;
+        if (!reference(sensor.sensorCoeffs, d1s[k], d2, temp, pressure)) {
+          skipped++;
+          continue;
+        }
+        checked++;
+        if (temp >= FLOAT_MIN_TEMP && temp <= FLOAT_MAX_TEMP
+            && pressure >= 0 && pressure <= FLOAT_MAX_PRESSURE) {
+          floatChecked++;
+          sensor.setConversion(MS5803_CONVERT_FLOAT);
+          sensor.convertRaw(d1s[k], d2);
+          int32_t tempError = abs(sensor.temperatureInt() - temp);
+          int32_t pressureError = abs(sensor.pressureInt() - pressure);
+          floatTempError = max(floatTempError, tempError);
+          floatPressureError = max(floatPressureError, pressureError);
+          if (tempError > FLOAT_TEMP_ERROR || pressureError > FLOAT_PRESSURE_ERROR) {
+            floatMismatches++;
+          }
+        }
+        sensor.setConversion(MS5803_CONVERT_LUT);
+        sensor.convertRaw(d1s[k], d2);
+        if (sensor.temperatureInt() != temp || sensor.pressureInt() != pressure) {
+          lutMismatches++;
+        }
+        sensor.setConversion(MS5803_CONVERT_INTEGER);
+        sensor.convertRaw(d1s[k], d2);
+        if (sensor.temperatureInt() != temp || sensor.pressureInt() != pressure) {
+          if (mismatches++ < 5) {
+            Serial.print("Mismatch: set ");
+            Serial.print(set);
+            Serial.print(" D1 ");
+            Serial.print(d1s[k]);
+            Serial.print(" D2 ");
+            Serial.println(d2);
+          }
+        }
+      }
+    }
+  }
+  report("verify", "checked", checked);
+  report("verify", "skipped", skipped);
+  report("verify", "mismatches", mismatches);
+  report("verifyLUT", "mismatches", lutMismatches);
+  report("verifyFloat", "checked", floatChecked);
+  report("verifyFloat", "maxTempError", floatTempError);
+  report("verifyFloat", "maxPressureError", floatPressureError);
+  report("verifyFloat", "mismatches", floatMismatches);
+  Serial.println(mismatches == 0 && lutMismatches == 0 && floatMismatches == 0
+                 && floatChecked > 0 ? "PASS" : "FAIL");
+}
+
+void loop() {
+}